@@ -0,0 +1,87 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: open-addressing hash-table, Robin Hood linear probing with
+         backward-shift deletion and a 1-byte fingerprint per slot.
+   Ref: [Gonnet 1984], [Knuth 1998], [Celis 1986].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef CCL_CHASHTABLE_H
+#define CCL_CHASHTABLE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <classic/common.h>
+#include <classic/map.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Concurrent chained hash-table: the table may be used from many threads at
+ * once, select and foreach never take a lock.  Keys and values freed by a
+ * delete, clear or resize are released only once no reader can still see
+ * them; the allocator, if any, must be thread-safe.  CCL_HT_POW2 works as
+ * for ccl_ht1, CCL_HT_INCREMENTAL and CCL_POOL are ignored.  A value found
+ * by select may be used safely inside a ccl_epoch section, see epoch.h.
+ */
+struct ccl_cht_table_t;
+struct ccl_cht_stripe_t;
+
+typedef struct ccl_cht_node_t {
+	struct ccl_cht_node_t *next;
+	void *key;
+	void *value;
+	uint64_t hash;
+} ccl_cht_node;
+
+typedef struct ccl_cht_t {
+	struct ccl_cht_table_t *table;		// bucket array, replaced by a resize
+	struct ccl_cht_stripe_t *stripes;	// writer locks, see chashtable.c
+	ccl_cmp_cb cmp;
+	ccl_free_cb kfree;
+	ccl_free_cb vfree;
+	ccl_hash_cb hash;
+	ccl_hash64_cb hash64;
+	const ccl_allocator *allocator;
+	unsigned flags;
+} ccl_cht;
+
+ccl_cht *ccl_cht_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size);
+ccl_cht *ccl_cht_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+ccl_cht *ccl_cht_new64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+size_t ccl_cht_count(ccl_cht *ht);
+size_t ccl_cht_clear(ccl_cht *ht);
+void ccl_cht_free(ccl_cht *ht);
+bool ccl_cht_select(ccl_cht *ht, void *k, void **v);
+bool ccl_cht_insert(ccl_cht *ht, void *k, void *v, void **pv);
+bool ccl_cht_delete(ccl_cht *ht, void *key);
+bool ccl_cht_foreach(ccl_cht *ht, ccl_dforeach_cb cb, void *user);
+
+/* unsorted map */
+ccl_map *ccl_umap_cht(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size);
+ccl_map *ccl_umap_cht_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+ccl_map *ccl_umap_cht_64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,8 @@
 #ifndef CCL_COMMON_H
 #define CCL_COMMON_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #ifdef  __cplusplus
@@ -32,6 +34,25 @@ typedef int		(* ccl_cmp_cb)(const void *, const void *);
 typedef bool		(* ccl_sforeach_cb)(void *, void *);
 typedef bool		(* ccl_dforeach_cb)(const void *, void *, void *);
 typedef unsigned	(* ccl_hash_cb)(const void *);
+typedef uint64_t	(* ccl_key64_cb)(const void *);
+typedef uint64_t	(* ccl_hash64_cb)(const void *);
+
+/*
+ * Memory allocator for *_new_ex() constructors, NULL selects malloc/free.
+ * Containers keep the pointer, so the allocator must outlive them.  free
+ * may be a no-op, e.g. for an arena that is released as a whole.
+ */
+typedef struct ccl_allocator_t {
+	void *(* alloc)(void *ctx, size_t size);
+	void *(* realloc)(void *ctx, void *ptr, size_t size);
+	void (* free)(void *ctx, void *ptr);
+	void *ctx;
+} ccl_allocator;
+
+/* *_new_ex() flags */
+#define CCL_HT_INCREMENTAL	0x0001U		// hash tables: resize a few buckets per operation
+#define CCL_HT_POW2		0x0002U		// hash tables: power of two size, mixed hash
+#define CCL_POOL		0x0004U		// node containers: allocate nodes from a ccl_pool
 
 #define container_of(ptr, type, member) ((type *)((char *)(__typeof__(((type *)0)->member) *){ ptr } - offsetof(type, member)))
 
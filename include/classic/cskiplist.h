@@ -0,0 +1,90 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: skiplist implementation.
+   Ref: [Pugh 1990], [Sedgewick 1998].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+
+#ifndef CCL_CSKIPLIST_H
+#define CCL_CSKIPLIST_H
+
+#include <stdlib.h>
+
+#include <classic/common.h>
+#include <classic/map.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Lock-free skiplist: any number of threads may select, insert, delete
+ * and scan at once.  Scans see every entry present for their whole
+ * duration and may or may not see concurrent changes.  Deleted keys and
+ * values are freed once no reader can still see them; the allocator, if
+ * any, must be thread-safe.  Node heights are drawn per thread with
+ * p = 1/4, up to max_link (at most 32).  CCL_POOL is ignored.  Entries
+ * found by select or a scan may be used safely inside a ccl_epoch section,
+ * see epoch.h.
+ */
+typedef struct ccl_cskipnode_t {
+	void *key;
+	void *value;
+	union {
+		struct {
+			unsigned link_count;
+			unsigned state;		// insert/delete progress, see cskiplist.c
+		} n;
+		struct ccl_cskipnode_t *deferred;	// next node waiting to be retired
+	} u;
+	struct ccl_cskipnode_t *link[];		// low bit set: node is being deleted
+} ccl_cskipnode;
+
+typedef struct ccl_cskiplist_t {
+	struct ccl_cskipnode_t *head;
+	ccl_cmp_cb cmp;
+	ccl_free_cb kfree;
+	ccl_free_cb vfree;
+	unsigned max_link;
+	unsigned top_link;			// highest level ever used, only grows
+	struct ccl_cskipnode_t *deferred;	// nodes the epoch code had no room for
+	const ccl_allocator *allocator;
+} ccl_cskiplist;
+
+ccl_cskiplist *ccl_cskiplist_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link);
+ccl_cskiplist *ccl_cskiplist_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link, unsigned flags, const ccl_allocator *allocator);
+size_t ccl_cskiplist_clear(ccl_cskiplist *list);
+void ccl_cskiplist_free(ccl_cskiplist *list);
+bool ccl_cskiplist_select(ccl_cskiplist *list, void *k, void **v);
+bool ccl_cskiplist_insert(ccl_cskiplist *list, void *k, void *v, void **pv);
+bool ccl_cskiplist_delete(ccl_cskiplist *list, void *key);
+bool ccl_cskiplist_foreach(ccl_cskiplist *list, ccl_dforeach_cb cb, void *user);
+bool ccl_cskiplist_lower_bound(ccl_cskiplist *list, const void *k, void **key, void **value);
+bool ccl_cskiplist_upper_bound(ccl_cskiplist *list, const void *k, void **key, void **value);
+bool ccl_cskiplist_range_foreach(ccl_cskiplist *list, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* sorted map */
+ccl_map *ccl_smap_cskiplist(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link);
+ccl_map *ccl_smap_cskiplist_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link, unsigned flags, const ccl_allocator *allocator);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef CCL_EPOCH_H
+#define CCL_EPOCH_H
+
+#include <stdbool.h>
+
+#include <classic/common.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Epoch based memory reclamation, shared by the concurrent containers and
+ * usable by any code that reads shared nodes without locks.  Readers
+ * bracket every traversal with ccl_epoch_enter() and ccl_epoch_exit();
+ * writers hand memory they unlinked to ccl_epoch_retire() instead of
+ * freeing it, and it is released once every thread that could still see
+ * it has left its critical section.  Sections nest and are cheap: a store
+ * and a fence.  A key or value obtained from ccl_cht or ccl_cskiplist
+ * stays valid for as long as the caller stays inside a section.
+ *
+ * Threads register on their first enter or retire, or explicitly with
+ * ccl_epoch_register(); a record is given back on thread exit or by
+ * ccl_epoch_unregister(), and what it still holds is handed on with it.
+ * By default a thread runs the callbacks of its own retired memory every
+ * 64 retires; with the background reclaimer started retiring only queues,
+ * and a library thread releases the memory of every thread.
+ *
+ * ccl_epoch_synchronize(), ccl_epoch_barrier() and ccl_epoch_unregister()
+ * must not be called from inside a critical section.  ccl_epoch_barrier()
+ * returns only once no callback of earlier retired memory is still
+ * running on any thread, so it must not be called from a callback either.
+ */
+typedef void (* ccl_epoch_cb)(void *ctx, void *p);
+
+bool ccl_epoch_register(void);
+void ccl_epoch_unregister(void);
+bool ccl_epoch_enter(void);
+void ccl_epoch_exit(void);
+bool ccl_epoch_retire(void *p, ccl_free_cb free_cb);
+bool ccl_epoch_retire_ex(void *p, ccl_epoch_cb cb, void *ctx);
+void ccl_epoch_reclaim(void);
+void ccl_epoch_synchronize(void);
+void ccl_epoch_barrier(void);
+bool ccl_epoch_reclaimer_start(unsigned interval_ms);
+void ccl_epoch_reclaimer_stop(void);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -24,9 +24,11 @@
 #define CCL_HASHTABLE1_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -38,20 +40,29 @@ typedef struct ccl_ht1_node_t {
 	struct ccl_ht1_node_t *next;
 	void *key;
 	void *value;
-	unsigned hash;
+	uint64_t hash;
 } ccl_ht1_node;
 
 typedef struct ccl_ht1_t {
 	ccl_ht1_node **table;
+	ccl_ht1_node **otable;		// buckets not yet migrated by a resize
 	ccl_cmp_cb cmp;
 	ccl_free_cb kfree;
 	ccl_free_cb vfree;
 	ccl_hash_cb hash;
+	ccl_hash64_cb hash64;		// set by ccl_ht1_new64, then hash is NULL
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 	size_t count;
-	unsigned size;
+	size_t size;
+	size_t osize;
+	size_t migrate;		// first bucket of otable still in use
+	unsigned flags;
 } ccl_ht1;
 
-ccl_ht1 *ccl_ht1_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned size);
+ccl_ht1 *ccl_ht1_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size);
+ccl_ht1 *ccl_ht1_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+ccl_ht1 *ccl_ht1_new64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
 size_t ccl_ht1_clear(ccl_ht1 *ht);
 void ccl_ht1_free(ccl_ht1 *ht);
 bool ccl_ht1_select(ccl_ht1 *ht, void *k, void **v);
@@ -59,9 +70,17 @@ bool ccl_ht1_insert(ccl_ht1 *ht, void *k, void *v, void **);
 bool ccl_ht1_unlink(ccl_ht1 *ht, void *key, void **k, void **v);
 bool ccl_ht1_delete(ccl_ht1 *ht, void *key);
 bool ccl_ht1_foreach(ccl_ht1 *ht, ccl_dforeach_cb cb, void *user);
+size_t ccl_ht1_insert_batch(ccl_ht1 *ht, void **keys, void **values, size_t n);
+size_t ccl_ht1_select_batch(ccl_ht1 *ht, void **keys, size_t n, void **values);
+size_t ccl_ht1_delete_batch(ccl_ht1 *ht, void **keys, size_t n);
+bool ccl_ht1_select_hashed(ccl_ht1 *ht, void *k, uint64_t hash, void **v);
+bool ccl_ht1_insert_hashed(ccl_ht1 *ht, void *k, void *v, uint64_t hash, void **pv);
+bool ccl_ht1_delete_hashed(ccl_ht1 *ht, void *key, uint64_t hash);
 
 /* unsorted map */
-ccl_map *ccl_umap_ht1(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned size);
+ccl_map *ccl_umap_ht1(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size);
+ccl_map *ccl_umap_ht1_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+ccl_map *ccl_umap_ht1_64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
 
 #ifdef  __cplusplus
 }
@@ -3,8 +3,9 @@
 
    This file is part of libclassic.
    Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
-   Algo: open-addressing hash-table interface.
-   Ref: [Gonnet 1984], [Knuth 1998].
+   Algo: open-addressing hash-table, Robin Hood linear probing with
+         backward-shift deletion and a 1-byte fingerprint per slot.
+   Ref: [Gonnet 1984], [Knuth 1998], [Celis 1986].
 
    The GNU C Library is free software; you can redistribute it and/or
    modify it under the terms of the GNU Lesser General Public
@@ -24,6 +25,7 @@
 #define CCL_HASHTABLE2_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include <classic/common.h>
 #include <classic/map.h>
@@ -35,20 +37,26 @@ extern "C" {
 typedef struct ccl_ht2_node_t {
 	void *key;
 	void *value;
-	unsigned hash;
+	uint64_t hash;
 } ccl_ht2_node;
 
 typedef struct ccl_ht2_t {
 	ccl_ht2_node *table;
+	unsigned char *ctrl;		// per slot fingerprint, see hashtable2.c
 	ccl_cmp_cb cmp;
 	ccl_free_cb kfree;
 	ccl_free_cb vfree;
 	ccl_hash_cb hash;
+	ccl_hash64_cb hash64;		// set by ccl_ht2_new64, then hash is NULL
 	size_t count;
-	unsigned size;
+	size_t size;
+	unsigned flags;
+	const ccl_allocator *allocator;
 } ccl_ht2;
 
-ccl_ht2 *ccl_ht2_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned int size);
+ccl_ht2 *ccl_ht2_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size);
+ccl_ht2 *ccl_ht2_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+ccl_ht2 *ccl_ht2_new64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
 size_t ccl_ht2_clear(ccl_ht2 *ht);
 void ccl_ht2_free(ccl_ht2 *ht);
 bool ccl_ht2_select(ccl_ht2 *ht, void *k, void **v);
@@ -56,9 +64,17 @@ bool ccl_ht2_insert(ccl_ht2 *ht, void *k, void *v, void **);
 bool ccl_ht2_unlink(ccl_ht2 *ht, void *key, void **k, void **v);
 bool ccl_ht2_delete(ccl_ht2 *ht, void *key);
 bool ccl_ht2_foreach(ccl_ht2 *ht, ccl_dforeach_cb cb, void *user);
+size_t ccl_ht2_insert_batch(ccl_ht2 *ht, void **keys, void **values, size_t n);
+size_t ccl_ht2_select_batch(ccl_ht2 *ht, void **keys, size_t n, void **values);
+size_t ccl_ht2_delete_batch(ccl_ht2 *ht, void **keys, size_t n);
+bool ccl_ht2_select_hashed(ccl_ht2 *ht, void *k, uint64_t hash, void **v);
+bool ccl_ht2_insert_hashed(ccl_ht2 *ht, void *k, void *v, uint64_t hash, void **pv);
+bool ccl_ht2_delete_hashed(ccl_ht2 *ht, void *key, uint64_t hash);
 
 /* unsorted map */
-ccl_map *ccl_umap_ht2(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned size);
+ccl_map *ccl_umap_ht2(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size);
+ccl_map *ccl_umap_ht2_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
+ccl_map *ccl_umap_ht2_64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator);
 
 #ifdef  __cplusplus
 }
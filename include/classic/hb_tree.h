@@ -27,6 +27,7 @@
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -47,6 +48,8 @@ typedef struct ccl_hbtree_t {
 	ccl_free_cb kfree;
 	ccl_free_cb vfree;
 	size_t count;
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 } ccl_hbtree;
 
 typedef struct ccl_hbtree_iter_t {
@@ -55,6 +58,7 @@ typedef struct ccl_hbtree_iter_t {
 } ccl_hbtree_iter;
 
 ccl_hbtree *ccl_hbtree_new(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_hbtree *ccl_hbtree_new_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 size_t ccl_hbtree_clear(ccl_hbtree *tree);
 void ccl_hbtree_free(ccl_hbtree *tree);
 bool ccl_hbtree_select(ccl_hbtree *tree, void *k, void **v);
@@ -62,9 +66,24 @@ bool ccl_hbtree_insert(ccl_hbtree *tree, void *k, void *v, void **);
 bool ccl_hbtree_unlink(ccl_hbtree *tree, void *key, void **k, void **v);
 bool ccl_hbtree_delete(ccl_hbtree *tree, void *k);
 bool ccl_hbtree_foreach(ccl_hbtree *tree, ccl_dforeach_cb cb, void *user);
+bool ccl_hbtree_build_sorted(ccl_hbtree *tree, void **keys, void **values, size_t n);
+bool ccl_hbtree_lower_bound(ccl_hbtree *tree, const void *k, void **key, void **value);
+bool ccl_hbtree_upper_bound(ccl_hbtree *tree, const void *k, void **key, void **value);
+bool ccl_hbtree_range_foreach(ccl_hbtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* in-order iterators, valid until the container is modified */
+void ccl_hbtree_iter_init(ccl_hbtree_iter *it, ccl_hbtree *tree);
+bool ccl_hbtree_iter_begin(ccl_hbtree_iter *it);
+bool ccl_hbtree_iter_end(ccl_hbtree_iter *it);
+bool ccl_hbtree_iter_seek(ccl_hbtree_iter *it, const void *k);
+bool ccl_hbtree_iter_next(ccl_hbtree_iter *it);
+bool ccl_hbtree_iter_prev(ccl_hbtree_iter *it);
+void *ccl_hbtree_iter_key(ccl_hbtree_iter *it);
+void *ccl_hbtree_iter_value(ccl_hbtree_iter *it);
 
 /* sorted map */
 ccl_map *ccl_smap_hbtree(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_map *ccl_smap_hbtree_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 
 #ifdef  __cplusplus
 }
@@ -31,9 +31,15 @@ extern "C" {
 #endif
 
 typedef void ccl_list;
-typedef void ccl_list_iter;
+
+// public so that iterators can live on the stack, see ccl_list_iter_init()
+typedef struct ccl_list_iter_t {
+	struct ccl_list_node_t *node;
+	struct ccl_list_t *list;
+} ccl_list_iter;
 
 ccl_list *ccl_list_new(ccl_cmp_cb, ccl_free_cb);
+ccl_list *ccl_list_new_ex(ccl_cmp_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 void ccl_list_free(ccl_list *);
 void ccl_list_init(ccl_list *, ccl_cmp_cb, ccl_free_cb);
 void ccl_list_clear(ccl_list *);
@@ -47,6 +53,7 @@ size_t ccl_list_count(ccl_list *);
 bool ccl_list_empty(ccl_list *);
 bool ccl_list_sorted(ccl_list *);
 
+void ccl_list_iter_init(ccl_list_iter *, ccl_list *);
 ccl_list_iter *ccl_list_iter_new(ccl_list *);
 void ccl_list_iter_free(ccl_list_iter *);
 void *ccl_list_iter_unlink(ccl_list_iter *);
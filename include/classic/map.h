@@ -30,12 +30,26 @@
 extern "C" {
 #endif
 
+struct ccl_map_iter_t;
+
 typedef void		(* ccl_map_free_cb)(void *obj);
 typedef size_t		(* ccl_map_clear_cb)(void *obj);
 typedef bool		(* ccl_map_select_cb)(void *obj, const void *k, void **v);
 typedef bool		(* ccl_map_insert_cb)(void *obj, const void *k, void *v, void **pv);
 typedef bool		(* ccl_map_delete_cb)(void *obj, const void *k);
 typedef bool		(* ccl_map_foreach_cb)(void *obj, ccl_dforeach_cb cb, void *user);
+typedef bool		(* ccl_map_build_cb)(void *obj, void **keys, void **values, size_t n);
+typedef bool		(* ccl_map_bound_cb)(void *obj, const void *k, void **key, void **value);
+typedef bool		(* ccl_map_range_cb)(void *obj, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+typedef size_t		(* ccl_map_insert_batch_cb)(void *obj, void **keys, void **values, size_t n);
+typedef size_t		(* ccl_map_select_batch_cb)(void *obj, void **keys, size_t n, void **values);
+typedef size_t		(* ccl_map_delete_batch_cb)(void *obj, void **keys, size_t n);
+typedef bool		(* ccl_map_select_hashed_cb)(void *obj, const void *k, uint64_t hash, void **v);
+typedef bool		(* ccl_map_insert_hashed_cb)(void *obj, const void *k, void *v, uint64_t hash, void **pv);
+typedef bool		(* ccl_map_delete_hashed_cb)(void *obj, const void *k, uint64_t hash);
+typedef bool		(* ccl_map_iter_cb)(struct ccl_map_iter_t *it);
+typedef bool		(* ccl_map_iter_seek_cb)(struct ccl_map_iter_t *it, const void *k);
+typedef void *		(* ccl_map_iter_get_cb)(struct ccl_map_iter_t *it);
 
 struct ccl_map_ops {
 	ccl_map_free_cb	free;
@@ -44,16 +58,60 @@ struct ccl_map_ops {
 	ccl_map_insert_cb	insert;
 	ccl_map_delete_cb	delete;
 	ccl_map_foreach_cb	foreach;
+	// optional, NULL where the backend has no native implementation
+	ccl_map_build_cb	build_sorted;
+	ccl_map_bound_cb	lower_bound;
+	ccl_map_bound_cb	upper_bound;
+	ccl_map_range_cb	range_foreach;
+	ccl_map_iter_cb	iter_begin;
+	ccl_map_iter_cb	iter_end;
+	ccl_map_iter_seek_cb	iter_seek;
+	ccl_map_iter_cb	iter_next;
+	ccl_map_iter_cb	iter_prev;
+	ccl_map_iter_get_cb	iter_key;
+	ccl_map_iter_get_cb	iter_value;
+	ccl_map_insert_batch_cb	insert_batch;
+	ccl_map_select_batch_cb	select_batch;
+	ccl_map_delete_batch_cb	delete_batch;
+	ccl_map_select_hashed_cb	select_hashed;
+	ccl_map_insert_hashed_cb	insert_hashed;
+	ccl_map_delete_hashed_cb	delete_hashed;
 };
 
 
 typedef struct ccl_map_t {
 	void *obj;
 	struct ccl_map_ops *ops;
+	const ccl_allocator *allocator;
 	bool sorted;
 } ccl_map;
 
+// node is the backend's position, obj the backend container, see src/mapiter.h
+typedef struct ccl_map_iter_t {
+	void *node;
+	void *obj;
+	struct ccl_map_t *map;
+} ccl_map_iter;
+
 void ccl_map_free(ccl_map *map);
+bool ccl_map_build_sorted(ccl_map *map, void **keys, void **values, size_t n);
+bool ccl_map_lower_bound(ccl_map *map, const void *k, void **key, void **value);
+bool ccl_map_upper_bound(ccl_map *map, const void *k, void **key, void **value);
+bool ccl_map_range_foreach(ccl_map *map, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+size_t ccl_map_insert_batch(ccl_map *map, void **keys, void **values, size_t n);
+size_t ccl_map_select_batch(ccl_map *map, void **keys, size_t n, void **values);
+size_t ccl_map_delete_batch(ccl_map *map, void **keys, size_t n);
+bool ccl_map_select_hashed(ccl_map *map, const void *k, uint64_t hash, void **v);
+bool ccl_map_insert_hashed(ccl_map *map, const void *k, void *v, uint64_t hash, void **pv);
+bool ccl_map_delete_hashed(ccl_map *map, const void *k, uint64_t hash);
+bool ccl_map_iter_init(ccl_map_iter *it, ccl_map *map);
+#define ccl_map_iter_begin(it)		(it)->map->ops->iter_begin(it)
+#define ccl_map_iter_end(it)		(it)->map->ops->iter_end(it)
+#define ccl_map_iter_seek(it,k)		(it)->map->ops->iter_seek((it), (k))
+#define ccl_map_iter_next(it)		(it)->map->ops->iter_next(it)
+#define ccl_map_iter_prev(it)		(it)->map->ops->iter_prev(it)
+#define ccl_map_iter_key(it)		(it)->map->ops->iter_key(it)
+#define ccl_map_iter_value(it)		(it)->map->ops->iter_value(it)
 #define ccl_map_clear(map)		(map)->ops->clear((map)->obj)
 #define ccl_map_select(map,k,v)		(map)->ops->select((map)->obj, (k), (v))
 #define ccl_map_insert(map,k,v,p)	(map)->ops->insert((map)->obj, (k), (v), (p))
@@ -61,6 +119,45 @@ void ccl_map_free(ccl_map *map);
 #define ccl_map_foreach(map,cb,u)	(map)->ops->foreach((map)->obj, (cb), (u))
 #define ccl_map_sorted(map)		(map)->sorted
 
+/*
+ * Left-right wrapper: a map many threads can share, built from two copies
+ * of any backend made by factory.  Readers never lock or wait; they run on
+ * one copy inside a ccl_epoch section while a writer, serialised by a
+ * mutex, changes the other copy, switches readers over and waits for the
+ * old ones to drain before repeating the change on the first copy.  Writes
+ * cost two backend operations and a ccl_epoch_synchronize(), so this suits
+ * read-mostly use.
+ *
+ * Both copies hold the same key and value pointers, so the backend must not
+ * free them (NULL kfree and vfree); a caller that wants to free what it
+ * deleted retires it with ccl_epoch_retire().  Readers share a copy, so
+ * the backend's lookups must be read-only: not sp_tree, which splays on
+ * select, nor ht1 with CCL_HT_INCREMENTAL, whose select moves chains of
+ * a pending resize.  Its allocator, if any, must be thread-safe.  insert
+ * stores NULL in *pv, as an update in place would reach one copy only.
+ * Callbacks run inside an epoch section and must not modify the map;
+ * writes must not be made from inside a section.
+ */
+typedef ccl_map *	(* ccl_map_factory_cb)(void *user);
+
+ccl_map *ccl_map_leftright(ccl_map_factory_cb factory, void *user);
+
+/*
+ * Sharded map: n maps made by factory, each behind its own lock, a key
+ * going to the shard picked by hash_cb.  hash_cb must be the hash
+ * callback of the shards, if they hash: its value is passed on to the
+ * shard's hashed select, insert and delete.  Threads working on different
+ * shards do not contend and a resize only ever stalls one shard.  With a
+ * cmp_cb and sorted shards the map is sorted: foreach, the bounds and
+ * range_foreach merge the shards in key order, the scans holding every
+ * shard lock; without one foreach visits the shards in turn, unordered.
+ * Callbacks run under a shard lock and must not use the map.  Anything a
+ * lookup returns, *pv included, stays valid only while no other thread
+ * deletes or updates that key, and the allocator, if any, must be
+ * thread-safe.
+ */
+ccl_map *ccl_map_sharded(unsigned n, ccl_map_factory_cb factory, void *user, ccl_hash_cb hash_cb, ccl_cmp_cb cmp_cb);
+
 #ifdef  __cplusplus
 }
 #endif
@@ -0,0 +1,57 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Algo: fixed-size object pool (slab), nodes carved from chunks
+         with an intrusive free list.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef CCL_POOL_H
+#define CCL_POOL_H
+
+#include <stdlib.h>
+
+#include <classic/common.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+struct ccl_pool_chunk_t;
+
+typedef struct ccl_pool_t {
+	void *free;			// released objects, linked through their first word
+	struct ccl_pool_chunk_t *chunks;
+	char *cur;			// unused tail of the newest chunk
+	char *end;
+	size_t size;			// object size, rounded up to the alignment
+	size_t nobjs;			// objects in the next chunk
+	const ccl_allocator *allocator;	// chunk allocator, NULL for libc
+} ccl_pool;
+
+ccl_pool *ccl_pool_new(size_t size);
+ccl_pool *ccl_pool_new_ex(size_t size, const ccl_allocator *allocator);
+void ccl_pool_free(ccl_pool *pool);
+void *ccl_pool_alloc(ccl_pool *pool);
+void ccl_pool_dealloc(ccl_pool *pool, void *p);
+void ccl_pool_clear(ccl_pool *pool);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
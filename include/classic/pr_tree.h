@@ -27,6 +27,7 @@
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -47,6 +48,8 @@ typedef struct ccl_prtree_t {
 	ccl_free_cb kfree;
 	ccl_free_cb vfree;
 	size_t count;
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 } ccl_prtree;
 
 typedef struct ccl_prtree_iter_t {
@@ -55,6 +58,7 @@ typedef struct ccl_prtree_iter_t {
 } ccl_prtree_iter;
 
 ccl_prtree *ccl_prtree_new(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_prtree *ccl_prtree_new_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 size_t ccl_prtree_clear(ccl_prtree *tree);
 void ccl_prtree_free(ccl_prtree *tree);
 bool ccl_prtree_select(ccl_prtree *tree, void *k, void **v);
@@ -62,9 +66,24 @@ bool ccl_prtree_insert(ccl_prtree *tree, void *k, void *v, void **);
 bool ccl_prtree_unlink(ccl_prtree *tree, void *key, void **k, void **v);
 bool ccl_prtree_delete(ccl_prtree *tree, void *k);
 bool ccl_prtree_foreach(ccl_prtree *tree, ccl_dforeach_cb cb, void *user);
+bool ccl_prtree_build_sorted(ccl_prtree *tree, void **keys, void **values, size_t n);
+bool ccl_prtree_lower_bound(ccl_prtree *tree, const void *k, void **key, void **value);
+bool ccl_prtree_upper_bound(ccl_prtree *tree, const void *k, void **key, void **value);
+bool ccl_prtree_range_foreach(ccl_prtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* in-order iterators, valid until the container is modified */
+void ccl_prtree_iter_init(ccl_prtree_iter *it, ccl_prtree *tree);
+bool ccl_prtree_iter_begin(ccl_prtree_iter *it);
+bool ccl_prtree_iter_end(ccl_prtree_iter *it);
+bool ccl_prtree_iter_seek(ccl_prtree_iter *it, const void *k);
+bool ccl_prtree_iter_next(ccl_prtree_iter *it);
+bool ccl_prtree_iter_prev(ccl_prtree_iter *it);
+void *ccl_prtree_iter_key(ccl_prtree_iter *it);
+void *ccl_prtree_iter_value(ccl_prtree_iter *it);
 
 /* sorted map */
 ccl_map *ccl_smap_prtree(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_map *ccl_smap_prtree_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 
 #ifdef  __cplusplus
 }
@@ -27,6 +27,7 @@
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -47,6 +48,8 @@ typedef struct ccl_rbtree_t {
 	ccl_free_cb kfree;
 	ccl_free_cb vfree;
 	size_t count;
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 } ccl_rbtree;
 
 typedef struct ccl_rbtree_iter_t {
@@ -55,6 +58,7 @@ typedef struct ccl_rbtree_iter_t {
 } ccl_rbtree_iter;
 
 ccl_rbtree *ccl_rbtree_new(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_rbtree *ccl_rbtree_new_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 size_t ccl_rbtree_clear(ccl_rbtree *tree);
 void ccl_rbtree_free(ccl_rbtree *tree);
 bool ccl_rbtree_select(ccl_rbtree *tree, void *k, void **v);
@@ -62,9 +66,24 @@ bool ccl_rbtree_insert(ccl_rbtree *tree, void *k, void *v, void **);
 bool ccl_rbtree_unlink(ccl_rbtree *tree, void *key, void **k, void **v);
 bool ccl_rbtree_delete(ccl_rbtree *tree, void *k);
 bool ccl_rbtree_foreach(ccl_rbtree *tree, ccl_dforeach_cb cb, void *user);
+bool ccl_rbtree_build_sorted(ccl_rbtree *tree, void **keys, void **values, size_t n);
+bool ccl_rbtree_lower_bound(ccl_rbtree *tree, const void *k, void **key, void **value);
+bool ccl_rbtree_upper_bound(ccl_rbtree *tree, const void *k, void **key, void **value);
+bool ccl_rbtree_range_foreach(ccl_rbtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* in-order iterators, valid until the container is modified */
+void ccl_rbtree_iter_init(ccl_rbtree_iter *it, ccl_rbtree *tree);
+bool ccl_rbtree_iter_begin(ccl_rbtree_iter *it);
+bool ccl_rbtree_iter_end(ccl_rbtree_iter *it);
+bool ccl_rbtree_iter_seek(ccl_rbtree_iter *it, const void *k);
+bool ccl_rbtree_iter_next(ccl_rbtree_iter *it);
+bool ccl_rbtree_iter_prev(ccl_rbtree_iter *it);
+void *ccl_rbtree_iter_key(ccl_rbtree_iter *it);
+void *ccl_rbtree_iter_value(ccl_rbtree_iter *it);
 
 /* sorted map */
 ccl_map *ccl_smap_rbtree(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_map *ccl_smap_rbtree_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 
 #ifdef  __cplusplus
 }
@@ -27,6 +27,7 @@
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -55,6 +56,8 @@ typedef struct ccl_skiplist_t {
 	unsigned max_link;
 	unsigned top_link;
 	size_t count;
+	ccl_pool **pools;		// node pools by height, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 } ccl_skiplist;
 
 typedef struct ccl_skiplist_iter_t {
@@ -63,6 +66,7 @@ typedef struct ccl_skiplist_iter_t {
 } ccl_skiplist_iter;
 
 ccl_skiplist *ccl_skiplist_new(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_maxlink_cb, unsigned);
+ccl_skiplist *ccl_skiplist_new_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_maxlink_cb, unsigned, unsigned, const ccl_allocator *);
 size_t ccl_skiplist_clear(ccl_skiplist *tree);
 void ccl_skiplist_free(ccl_skiplist *tree);
 bool ccl_skiplist_select(ccl_skiplist *tree, void *k, void **v);
@@ -70,9 +74,24 @@ bool ccl_skiplist_insert(ccl_skiplist *tree, void *k, void *v, void **);
 bool ccl_skiplist_unlink(ccl_skiplist *tree, void *key, void **k, void **v);
 bool ccl_skiplist_delete(ccl_skiplist *tree, void *k);
 bool ccl_skiplist_foreach(ccl_skiplist *tree, ccl_dforeach_cb cb, void *user);
+bool ccl_skiplist_build_sorted(ccl_skiplist *tree, void **keys, void **values, size_t n);
+bool ccl_skiplist_lower_bound(ccl_skiplist *tree, const void *k, void **key, void **value);
+bool ccl_skiplist_upper_bound(ccl_skiplist *tree, const void *k, void **key, void **value);
+bool ccl_skiplist_range_foreach(ccl_skiplist *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* in-order iterators, valid until the container is modified */
+void ccl_skiplist_iter_init(ccl_skiplist_iter *it, ccl_skiplist *tree);
+bool ccl_skiplist_iter_begin(ccl_skiplist_iter *it);
+bool ccl_skiplist_iter_end(ccl_skiplist_iter *it);
+bool ccl_skiplist_iter_seek(ccl_skiplist_iter *it, const void *k);
+bool ccl_skiplist_iter_next(ccl_skiplist_iter *it);
+bool ccl_skiplist_iter_prev(ccl_skiplist_iter *it);
+void *ccl_skiplist_iter_key(ccl_skiplist_iter *it);
+void *ccl_skiplist_iter_value(ccl_skiplist_iter *it);
 
 /* sorted map */
 ccl_map *ccl_smap_skiplist(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_maxlink_cb, unsigned);
+ccl_map *ccl_smap_skiplist_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_maxlink_cb, unsigned, unsigned, const ccl_allocator *);
 
 #ifdef  __cplusplus
 }
@@ -0,0 +1,73 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef CCL_SORT_H
+#define CCL_SORT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <classic/common.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Comparators recognised by ccl_sort() and ccl_vector_sort(), which then
+ * run a specialization with the comparison inlined: stored pointers
+ * compared as unsigned or signed integers, or as C strings.
+ */
+int ccl_cmp_uintptr(const void *, const void *);
+int ccl_cmp_intptr(const void *, const void *);
+int ccl_cmp_str(const void *, const void *);
+
+// unstable in-place sorts, O(n log n) worst case, O(n) on sorted or reversed input
+void ccl_sort(void **, size_t, ccl_cmp_cb);
+void ccl_sort_u64(uint64_t *, size_t);
+void ccl_sort_i64(int64_t *, size_t);
+void ccl_sort_double(double *, size_t);
+void ccl_sort_str(char **, size_t);
+
+/*
+ * Multithreaded ccl_sort(): chunks are sorted concurrently, then merged in
+ * parallel passes through an n-pointer scratch buffer.  nthreads 0 picks
+ * the number of online CPUs; small inputs, a failed scratch allocation or
+ * a build without pthreads fall back to the serial sort.
+ */
+void ccl_sort_parallel(void **, size_t, ccl_cmp_cb, unsigned);
+void ccl_sort_parallel_ex(void **, size_t, ccl_cmp_cb, unsigned, const ccl_allocator *);
+
+/*
+ * Stable LSD radix sort by an extracted unsigned 64-bit key, O(n) with one
+ * key call per item.  Inputs below cutoff items (CCL_RADIX_CUTOFF is a
+ * sensible default), or when the 32 bytes per item of scratch space cannot
+ * be allocated, are sorted by comparing keys instead, which is not stable.
+ */
+#define CCL_RADIX_CUTOFF	256
+
+void ccl_sort_radix(void **, size_t, ccl_key64_cb, size_t);
+void ccl_sort_radix_ex(void **, size_t, ccl_key64_cb, size_t, const ccl_allocator *);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -27,6 +27,7 @@
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -46,6 +47,8 @@ typedef struct ccl_sptree_t {
 	ccl_free_cb kfree;
 	ccl_free_cb vfree;
 	size_t count;
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 } ccl_sptree;
 
 typedef struct ccl_sptree_iter_t {
@@ -54,6 +57,7 @@ typedef struct ccl_sptree_iter_t {
 } ccl_sptree_iter;
 
 ccl_sptree *ccl_sptree_new(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_sptree *ccl_sptree_new_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 size_t ccl_sptree_clear(ccl_sptree *tree);
 void ccl_sptree_free(ccl_sptree *tree);
 bool ccl_sptree_select(ccl_sptree *tree, void *k, void **v);
@@ -61,9 +65,24 @@ bool ccl_sptree_insert(ccl_sptree *tree, void *k, void *v, void **);
 bool ccl_sptree_unlink(ccl_sptree *tree, void *key, void **k, void **v);
 bool ccl_sptree_delete(ccl_sptree *tree, void *k);
 bool ccl_sptree_foreach(ccl_sptree *tree, ccl_dforeach_cb cb, void *user);
+bool ccl_sptree_build_sorted(ccl_sptree *tree, void **keys, void **values, size_t n);
+bool ccl_sptree_lower_bound(ccl_sptree *tree, const void *k, void **key, void **value);
+bool ccl_sptree_upper_bound(ccl_sptree *tree, const void *k, void **key, void **value);
+bool ccl_sptree_range_foreach(ccl_sptree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* in-order iterators, valid until the container is modified */
+void ccl_sptree_iter_init(ccl_sptree_iter *it, ccl_sptree *tree);
+bool ccl_sptree_iter_begin(ccl_sptree_iter *it);
+bool ccl_sptree_iter_end(ccl_sptree_iter *it);
+bool ccl_sptree_iter_seek(ccl_sptree_iter *it, const void *k);
+bool ccl_sptree_iter_next(ccl_sptree_iter *it);
+bool ccl_sptree_iter_prev(ccl_sptree_iter *it);
+void *ccl_sptree_iter_key(ccl_sptree_iter *it);
+void *ccl_sptree_iter_value(ccl_sptree_iter *it);
 
 /* sorted map */
 ccl_map *ccl_smap_sptree(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_map *ccl_smap_sptree_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 
 #ifdef  __cplusplus
 }
@@ -28,6 +28,7 @@
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -51,6 +52,8 @@ typedef struct ccl_trtree_t {
 	ccl_free_cb vfree;
 	ccl_prio_cb prio;
 	size_t count;
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 } ccl_trtree;
 
 typedef struct ccl_trtree_iter_t {
@@ -59,6 +62,7 @@ typedef struct ccl_trtree_iter_t {
 } ccl_trtree_iter;
 
 ccl_trtree *ccl_trtree_new(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_prio_cb);
+ccl_trtree *ccl_trtree_new_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_prio_cb, unsigned, const ccl_allocator *);
 size_t ccl_trtree_clear(ccl_trtree *tree);
 void ccl_trtree_free(ccl_trtree *tree);
 bool ccl_trtree_select(ccl_trtree *tree, void *k, void **v);
@@ -66,9 +70,24 @@ bool ccl_trtree_insert(ccl_trtree *tree, void *k, void *v, void **);
 bool ccl_trtree_unlink(ccl_trtree *tree, void *key, void **k, void **v);
 bool ccl_trtree_delete(ccl_trtree *tree, void *k);
 bool ccl_trtree_foreach(ccl_trtree *tree, ccl_dforeach_cb cb, void *user);
+bool ccl_trtree_build_sorted(ccl_trtree *tree, void **keys, void **values, size_t n);
+bool ccl_trtree_lower_bound(ccl_trtree *tree, const void *k, void **key, void **value);
+bool ccl_trtree_upper_bound(ccl_trtree *tree, const void *k, void **key, void **value);
+bool ccl_trtree_range_foreach(ccl_trtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* in-order iterators, valid until the container is modified */
+void ccl_trtree_iter_init(ccl_trtree_iter *it, ccl_trtree *tree);
+bool ccl_trtree_iter_begin(ccl_trtree_iter *it);
+bool ccl_trtree_iter_end(ccl_trtree_iter *it);
+bool ccl_trtree_iter_seek(ccl_trtree_iter *it, const void *k);
+bool ccl_trtree_iter_next(ccl_trtree_iter *it);
+bool ccl_trtree_iter_prev(ccl_trtree_iter *it);
+void *ccl_trtree_iter_key(ccl_trtree_iter *it);
+void *ccl_trtree_iter_value(ccl_trtree_iter *it);
 
 /* sorted map */
 ccl_map *ccl_smap_trtree(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_prio_cb);
+ccl_map *ccl_smap_trtree_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, ccl_prio_cb, unsigned, const ccl_allocator *);
 
 #ifdef  __cplusplus
 }
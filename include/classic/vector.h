@@ -31,9 +31,15 @@ extern "C" {
 #endif
 
 typedef void ccl_vector;
-typedef void ccl_vector_iter;
+
+// public so that iterators can live on the stack, see ccl_vector_iter_init()
+typedef struct ccl_vector_iter_t {
+	size_t index;
+	struct ccl_vector_t *vec;
+} ccl_vector_iter;
 
 ccl_vector *ccl_vector_new(ccl_cmp_cb, ccl_free_cb);
+ccl_vector *ccl_vector_new_ex(ccl_cmp_cb, ccl_free_cb, const ccl_allocator *);
 void ccl_vector_init(ccl_vector *, ccl_cmp_cb, ccl_free_cb);
 void ccl_vector_free(ccl_vector *);
 void ccl_vector_clear(ccl_vector *);
@@ -55,10 +61,21 @@ bool ccl_vector_push_head(ccl_vector *, void *);
 bool ccl_vector_pop_head(ccl_vector *, void **);
 bool ccl_vector_foreach(ccl_vector *, ccl_sforeach_cb, void *);
 bool ccl_vector_sort(ccl_vector *);
+bool ccl_vector_sort_parallel(ccl_vector *, unsigned);
+bool ccl_vector_sort_radix(ccl_vector *, ccl_key64_cb, size_t);
+bool ccl_vector_bsearch(ccl_vector *, const void *, size_t *);
+bool ccl_vector_lower_bound(ccl_vector *, const void *, size_t *);
+bool ccl_vector_upper_bound(ccl_vector *, const void *, size_t *);
+bool ccl_vector_insert_sorted(ccl_vector *, void *);
+bool ccl_vector_merge(ccl_vector *, ccl_vector *);
 size_t ccl_vector_count(ccl_vector *);
 bool ccl_vector_empty(ccl_vector *);
 bool ccl_vector_sorted(ccl_vector *);
+bool ccl_vector_reserve(ccl_vector *, size_t);
+bool ccl_vector_shrink_to_fit(ccl_vector *);
+size_t ccl_vector_capacity(ccl_vector *);
 
+void ccl_vector_iter_init(ccl_vector_iter *, ccl_vector *);
 ccl_vector_iter *ccl_vector_iter_new(ccl_vector *);
 void ccl_vector_iter_free(ccl_vector_iter *);
 void ccl_vector_iter_begin(ccl_vector_iter *);
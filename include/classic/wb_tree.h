@@ -28,6 +28,7 @@
 
 #include <classic/common.h>
 #include <classic/map.h>
+#include <classic/pool.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -48,6 +49,8 @@ typedef struct ccl_wbtree_t {
 	ccl_free_cb kfree;
 	ccl_free_cb vfree;
 	size_t count;
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 } ccl_wbtree;
 
 typedef struct ccl_wbtree_iter_t {
@@ -56,6 +59,7 @@ typedef struct ccl_wbtree_iter_t {
 } ccl_wbtree_iter;
 
 ccl_wbtree *ccl_wbtree_new(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_wbtree *ccl_wbtree_new_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 size_t ccl_wbtree_clear(ccl_wbtree *tree);
 void ccl_wbtree_free(ccl_wbtree *tree);
 bool ccl_wbtree_select(ccl_wbtree *tree, void *k, void **v);
@@ -63,9 +67,24 @@ bool ccl_wbtree_insert(ccl_wbtree *tree, void *k, void *v, void **);
 bool ccl_wbtree_unlink(ccl_wbtree *tree, void *key, void **k, void **v);
 bool ccl_wbtree_delete(ccl_wbtree *tree, void *k);
 bool ccl_wbtree_foreach(ccl_wbtree *tree, ccl_dforeach_cb cb, void *user);
+bool ccl_wbtree_build_sorted(ccl_wbtree *tree, void **keys, void **values, size_t n);
+bool ccl_wbtree_lower_bound(ccl_wbtree *tree, const void *k, void **key, void **value);
+bool ccl_wbtree_upper_bound(ccl_wbtree *tree, const void *k, void **key, void **value);
+bool ccl_wbtree_range_foreach(ccl_wbtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user);
+
+/* in-order iterators, valid until the container is modified */
+void ccl_wbtree_iter_init(ccl_wbtree_iter *it, ccl_wbtree *tree);
+bool ccl_wbtree_iter_begin(ccl_wbtree_iter *it);
+bool ccl_wbtree_iter_end(ccl_wbtree_iter *it);
+bool ccl_wbtree_iter_seek(ccl_wbtree_iter *it, const void *k);
+bool ccl_wbtree_iter_next(ccl_wbtree_iter *it);
+bool ccl_wbtree_iter_prev(ccl_wbtree_iter *it);
+void *ccl_wbtree_iter_key(ccl_wbtree_iter *it);
+void *ccl_wbtree_iter_value(ccl_wbtree_iter *it);
 
 /* sorted map */
 ccl_map *ccl_smap_wbtree(ccl_cmp_cb, ccl_free_cb, ccl_free_cb);
+ccl_map *ccl_smap_wbtree_ex(ccl_cmp_cb, ccl_free_cb, ccl_free_cb, unsigned, const ccl_allocator *);
 
 #ifdef  __cplusplus
 }
@@ -0,0 +1,64 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef _CCL_ALLOCATOR_H
+#define _CCL_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <classic/common.h>
+
+/* allocation through a user ccl_allocator, or libc if there is none */
+static inline void *ccl_mem_alloc(const ccl_allocator *a, size_t size)
+{
+	return (a != NULL ? a->alloc(a->ctx, size) : malloc(size));
+}
+
+static inline void *ccl_mem_calloc(const ccl_allocator *a, size_t n, size_t size)
+{
+	void *p;
+
+	if (a == NULL)
+		return calloc(n, size);
+	if (size != 0 && n > SIZE_MAX / size)
+		return NULL;
+	p = a->alloc(a->ctx, n * size);
+	if (p != NULL)
+		memset(p, 0, n * size);
+	return p;
+}
+
+static inline void *ccl_mem_realloc(const ccl_allocator *a, void *ptr, size_t size)
+{
+	return (a != NULL ? a->realloc(a->ctx, ptr, size) : realloc(ptr, size));
+}
+
+static inline void ccl_mem_free(const ccl_allocator *a, void *ptr)
+{
+	if (a != NULL)
+		a->free(a->ctx, ptr);
+	else
+		free(ptr);
+	return;
+}
+
+#endif
@@ -0,0 +1,526 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: benchmark of every ccl_map backend on the same key streams.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <classic/map.h>
+#include <classic/rb_tree.h>
+#include <classic/hb_tree.h>
+#include <classic/wb_tree.h>
+#include <classic/pr_tree.h>
+#include <classic/tr_tree.h>
+#include <classic/sp_tree.h>
+#include <classic/skiplist.h>
+#include <classic/hashtable1.h>
+#include <classic/hashtable2.h>
+#include <classic/chashtable.h>
+#include <classic/cskiplist.h>
+
+/*
+ * Every run is executed in a forked child, so that peak RSS and the
+ * bytes-per-entry estimate belong to exactly one backend and one stream.
+ * Latency is sampled on every SAMPLE_RATE-th operation to keep the clock
+ * overhead out of the throughput figures.  A run that does not finish
+ * within the timeout is reported and the next one is started.
+ */
+
+#define SAMPLE_RATE		8
+#define DEFAULT_TIMEOUT		60
+#define SKIPLIST_LINKS		24
+
+/* random numbers */
+
+static uint64_t bench_rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t bench_random(void)
+{
+	uint64_t x = bench_rng;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	bench_rng = x;
+	return x;
+}
+
+static uint64_t bench_fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+/* callbacks shared by every backend */
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uintptr_t x = (uintptr_t)a, y = (uintptr_t)b;
+
+	return (x > y) - (x < y);
+}
+
+static unsigned bench_hash(const void *k)
+{
+	uint64_t x = (uintptr_t)k;
+
+	return (unsigned)(x ^ (x >> 32));
+}
+
+static unsigned bench_prio(const void *k)
+{
+	return (unsigned)bench_fmix64((uintptr_t)k);
+}
+
+static unsigned bench_maxlink(ccl_skiplist *list)
+{
+	unsigned links = 1;
+
+	while (links < list->max_link - 1 && (bench_random() & 3) == 0)
+		links++;
+	return links;
+}
+
+/* backends */
+
+static unsigned bench_flags;		// extra *_new_ex() flags, see -p
+
+static ccl_map *bench_rbtree(void)   { return ccl_smap_rbtree_ex(bench_cmp, NULL, NULL, bench_flags, NULL); }
+static ccl_map *bench_hbtree(void)   { return ccl_smap_hbtree_ex(bench_cmp, NULL, NULL, bench_flags, NULL); }
+static ccl_map *bench_wbtree(void)   { return ccl_smap_wbtree_ex(bench_cmp, NULL, NULL, bench_flags, NULL); }
+static ccl_map *bench_prtree(void)   { return ccl_smap_prtree_ex(bench_cmp, NULL, NULL, bench_flags, NULL); }
+static ccl_map *bench_trtree(void)   { return ccl_smap_trtree_ex(bench_cmp, NULL, NULL, bench_prio, bench_flags, NULL); }
+static ccl_map *bench_sptree(void)   { return ccl_smap_sptree_ex(bench_cmp, NULL, NULL, bench_flags, NULL); }
+static ccl_map *bench_skiplist(void) { return ccl_smap_skiplist_ex(bench_cmp, NULL, NULL, bench_maxlink, SKIPLIST_LINKS, bench_flags, NULL); }
+static ccl_map *bench_cskiplist(void) { return ccl_smap_cskiplist_ex(bench_cmp, NULL, NULL, SKIPLIST_LINKS, bench_flags, NULL); }
+static ccl_map *bench_ht1(void)      { return ccl_umap_ht1_ex(bench_cmp, NULL, NULL, bench_hash, 0, bench_flags, NULL); }
+static ccl_map *bench_ht1inc(void)   { return ccl_umap_ht1_ex(bench_cmp, NULL, NULL, bench_hash, 0, bench_flags | CCL_HT_INCREMENTAL, NULL); }
+static ccl_map *bench_ht1pow2(void)  { return ccl_umap_ht1_ex(bench_cmp, NULL, NULL, bench_hash, 0, bench_flags | CCL_HT_POW2, NULL); }
+static ccl_map *bench_ht2(void)      { return ccl_umap_ht2_ex(bench_cmp, NULL, NULL, bench_hash, 0, bench_flags, NULL); }
+static ccl_map *bench_ht2pow2(void)  { return ccl_umap_ht2_ex(bench_cmp, NULL, NULL, bench_hash, 0, bench_flags | CCL_HT_POW2, NULL); }
+static ccl_map *bench_cht(void)      { return ccl_umap_cht_ex(bench_cmp, NULL, NULL, bench_hash, 0, bench_flags, NULL); }
+static ccl_map *bench_ht2copy(void *user) { (void)user; return bench_ht2(); }
+static ccl_map *bench_leftright(void) { return ccl_map_leftright(bench_ht2copy, NULL); }
+static ccl_map *bench_sharded(void)  { return ccl_map_sharded(16, bench_ht2copy, NULL, bench_hash, NULL); }
+
+static const struct bench_backend {
+	const char *name;
+	ccl_map *(* create)(void);
+} backends[] = {
+	{ "rbtree",	bench_rbtree },
+	{ "hbtree",	bench_hbtree },
+	{ "wbtree",	bench_wbtree },
+	{ "prtree",	bench_prtree },
+	{ "trtree",	bench_trtree },
+	{ "sptree",	bench_sptree },
+	{ "skiplist",	bench_skiplist },
+	{ "cskiplist",	bench_cskiplist },
+	{ "ht1",	bench_ht1 },
+	{ "ht1inc",	bench_ht1inc },
+	{ "ht1pow2",	bench_ht1pow2 },
+	{ "ht2",	bench_ht2 },
+	{ "ht2pow2",	bench_ht2pow2 },
+	{ "cht",		bench_cht },
+	{ "leftright",	bench_leftright },
+	{ "sharded",	bench_sharded },
+};
+
+#define NUM_BACKENDS		(sizeof(backends) / sizeof(backends[0]))
+
+/* key streams: keys[] is the insert & delete order, probes[] the lookups */
+
+static void stream_uniform(uintptr_t *keys, uintptr_t *probes, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		keys[i] = bench_fmix64(i + 1);
+	for (i = 0; i < n; i++)
+		probes[i] = keys[bench_random() % n];
+	return;
+}
+
+/* Ref: [Gray et al. 1994], "Quickly generating billion-record synthetic databases" */
+static void stream_zipf(uintptr_t *keys, uintptr_t *probes, size_t n)
+{
+	const double theta = 0.99;
+	double zetan, zeta2, alpha, eta, u, uz;
+	size_t i, rank;
+
+	for (i = 0; i < n; i++)
+		keys[i] = bench_fmix64(i + 1);
+	zetan = 0.0;
+	for (i = 1; i <= n; i++)
+		zetan += 1.0 / pow((double)i, theta);
+	zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+	alpha = 1.0 / (1.0 - theta);
+	eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+	for (i = 0; i < n; i++) {
+		u = (double)(bench_random() >> 11) / (double)(1ULL << 53);
+		uz = u * zetan;
+		if (uz < 1.0)
+			rank = 0;
+		else if (uz < zeta2)
+			rank = 1;
+		else
+			rank = (size_t)(n * pow(eta * u - eta + 1.0, alpha));
+		if (rank >= n)
+			rank = n - 1;
+		probes[i] = keys[rank];
+	}
+	return;
+}
+
+static void stream_sequential(uintptr_t *keys, uintptr_t *probes, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		keys[i] = probes[i] = i + 1;
+	return;
+}
+
+/*
+ * Strided keys with identical low bits, inserted from both ends towards
+ * the middle: worst case for weak hashes and for rebalancing trees.
+ */
+static void stream_adversarial(uintptr_t *keys, uintptr_t *probes, size_t n)
+{
+	size_t i, lo, hi;
+
+	lo = 1;
+	hi = n;
+	for (i = 0; i < n; i++) {
+		if (i & 1)
+			keys[i] = (uintptr_t)(hi--) << 20;
+		else
+			keys[i] = (uintptr_t)(lo++) << 20;
+	}
+	for (i = 0; i < n; i++)
+		probes[i] = keys[n - 1 - i];
+	return;
+}
+
+static const struct bench_stream {
+	const char *name;
+	void (* fill)(uintptr_t *, uintptr_t *, size_t);
+} streams[] = {
+	{ "uniform",	stream_uniform },
+	{ "zipf",	stream_zipf },
+	{ "sequential",	stream_sequential },
+	{ "adversarial", stream_adversarial },
+};
+
+#define NUM_STREAMS		(sizeof(streams) / sizeof(streams[0]))
+
+/* log-linear latency histogram in nanoseconds */
+
+#define HIST_SUB_BITS		5
+#define HIST_SUB		(1U << HIST_SUB_BITS)
+#define HIST_SIZE		(HIST_SUB * 2 + HIST_SUB * 40)
+
+typedef struct bench_hist_t {
+	uint64_t bucket[HIST_SIZE];
+	uint64_t count;
+} bench_hist;
+
+static unsigned hist_index(uint64_t ns)
+{
+	unsigned e;
+
+	if (ns < 2 * HIST_SUB)
+		return (unsigned)ns;
+	e = 63 - __builtin_clzll(ns);
+	e = (e - HIST_SUB_BITS) * HIST_SUB + (unsigned)((ns >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+	e += HIST_SUB;
+	return e < HIST_SIZE ? e : HIST_SIZE - 1;
+}
+
+static uint64_t hist_value(unsigned index)
+{
+	unsigned e;
+
+	if (index < 2 * HIST_SUB)
+		return index;
+	index -= HIST_SUB;
+	e = index / HIST_SUB + HIST_SUB_BITS;
+	return ((uint64_t)(HIST_SUB + index % HIST_SUB)) << (e - HIST_SUB_BITS);
+}
+
+static uint64_t hist_percentile(bench_hist *h, double p)
+{
+	uint64_t want, seen;
+	unsigned i;
+
+	if (h->count == 0)
+		return 0;
+	want = (uint64_t)ceil(p * (double)h->count);
+	seen = 0;
+	for (i = 0; i < HIST_SIZE; i++) {
+		seen += h->bucket[i];
+		if (seen >= want)
+			return hist_value(i);
+	}
+	return hist_value(HIST_SIZE - 1);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t rss_bytes(void)
+{
+	FILE *f;
+	unsigned long size, resident;
+
+	f = fopen("/proc/self/statm", "r");
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/* one measured pass */
+
+enum { PHASE_INSERT, PHASE_SELECT, PHASE_DELETE, NUM_PHASES };
+
+static const char *phase_names[NUM_PHASES] = { "insert", "select", "delete" };
+
+typedef struct bench_phase_t {
+	bench_hist hist;
+	uint64_t elapsed;
+	size_t misses;
+} bench_phase;
+
+static bool bench_op(ccl_map *map, int phase, uintptr_t key)
+{
+	void *v, *pv;
+
+	switch (phase) {
+	case PHASE_INSERT:
+		return ccl_map_insert(map, (void *)key, (void *)key, &pv);
+	case PHASE_SELECT:
+		return ccl_map_select(map, (void *)key, &v);
+	default:
+		return ccl_map_delete(map, (void *)key);
+	}
+}
+
+static void bench_phase_run(ccl_map *map, int phase, const uintptr_t *keys, size_t n, bench_phase *res)
+{
+	uint64_t start, t0;
+	size_t i;
+
+	memset(res, 0, sizeof(*res));
+	start = now_ns();
+	for (i = 0; i < n; i++) {
+		if (i % SAMPLE_RATE) {
+			if (!bench_op(map, phase, keys[i]))
+				res->misses++;
+			continue;
+		}
+		t0 = now_ns();
+		if (!bench_op(map, phase, keys[i]))
+			res->misses++;
+		res->hist.bucket[hist_index(now_ns() - t0)]++;
+		res->hist.count++;
+	}
+	res->elapsed = now_ns() - start;
+	return;
+}
+
+static int bench_child(const struct bench_backend *be, const struct bench_stream *st, size_t n)
+{
+	bench_phase res[NUM_PHASES];
+	uintptr_t *keys, *probes;
+	struct rusage ru;
+	size_t rss0, rss1;
+	ccl_map *map;
+	int phase;
+
+	keys = malloc(n * sizeof(*keys));
+	probes = malloc(n * sizeof(*probes));
+	if (keys == NULL || probes == NULL)
+		return 1;
+	st->fill(keys, probes, n);
+
+	map = be->create();
+	if (map == NULL)
+		return 1;
+	rss0 = rss_bytes();
+	bench_phase_run(map, PHASE_INSERT, keys, n, &res[PHASE_INSERT]);
+	rss1 = rss_bytes();
+	bench_phase_run(map, PHASE_SELECT, probes, n, &res[PHASE_SELECT]);
+	bench_phase_run(map, PHASE_DELETE, keys, n, &res[PHASE_DELETE]);
+	ccl_map_free(map);
+	getrusage(RUSAGE_SELF, &ru);
+
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+		bench_phase *r = &res[phase];
+
+		printf("%-9s %-11s %10zu %-6s %12.0f %8llu %8llu %8llu %10ld %8.1f%s\n",
+		       be->name, st->name, n, phase_names[phase],
+		       r->elapsed ? (double)n * 1e9 / (double)r->elapsed : 0.0,
+		       (unsigned long long)hist_percentile(&r->hist, 0.50),
+		       (unsigned long long)hist_percentile(&r->hist, 0.99),
+		       (unsigned long long)hist_percentile(&r->hist, 0.999),
+		       ru.ru_maxrss,
+		       rss1 > rss0 ? (double)(rss1 - rss0) / (double)n : 0.0,
+		       r->misses ? " (misses)" : "");
+	}
+	fflush(stdout);
+	free(keys);
+	free(probes);
+	return 0;
+}
+
+static void bench_run(const struct bench_backend *be, const struct bench_stream *st, size_t n, unsigned timeout)
+{
+	pid_t pid;
+	int status;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return;
+	}
+	if (pid == 0) {
+		alarm(timeout);
+		_exit(bench_child(be, st, n));
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return;
+	if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+		printf("%-9s %-11s %10zu timeout (%us)\n", be->name, st->name, n, timeout);
+	else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		printf("%-9s %-11s %10zu failed\n", be->name, st->name, n);
+	return;
+}
+
+/* command line */
+
+static bool selected(const char *list, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p;
+
+	if (list == NULL)
+		return true;
+	for (p = list; (p = strstr(p, name)) != NULL; p += len) {
+		if ((p == list || p[-1] == ',') && (p[len] == '\0' || p[len] == ','))
+			return true;
+	}
+	return false;
+}
+
+static void usage(const char *prog)
+{
+	size_t i;
+
+	fprintf(stderr, "usage: %s [-b backends] [-w streams] [-n sizes] [-t seconds] [-p]\n", prog);
+	fprintf(stderr, "  -b  comma separated list of:");
+	for (i = 0; i < NUM_BACKENDS; i++)
+		fprintf(stderr, " %s", backends[i].name);
+	fprintf(stderr, "\n  -w  comma separated list of:");
+	for (i = 0; i < NUM_STREAMS; i++)
+		fprintf(stderr, " %s", streams[i].name);
+	fprintf(stderr, "\n  -n  comma separated sizes, e.g. 1e3,1e6,1e8 (default 1e3,1e4,1e5,1e6)\n");
+	fprintf(stderr, "  -t  per run timeout in seconds (default %u)\n", DEFAULT_TIMEOUT);
+	fprintf(stderr, "  -p  allocate nodes from a ccl_pool (CCL_POOL)\n");
+	return;
+}
+
+int main(int argc, char **argv)
+{
+	const char *blist = NULL, *wlist = NULL, *nlist = "1e3,1e4,1e5,1e6";
+	size_t sizes[32], nsizes, b, w, s;
+	unsigned timeout = DEFAULT_TIMEOUT;
+	char *p, *end;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:w:n:t:ph")) != -1) {
+		switch (opt) {
+		case 'b':
+			blist = optarg;
+			break;
+		case 'w':
+			wlist = optarg;
+			break;
+		case 'n':
+			nlist = optarg;
+			break;
+		case 't':
+			timeout = (unsigned)strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			bench_flags |= CCL_POOL;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	nsizes = 0;
+	for (p = (char *)nlist; *p && nsizes < sizeof(sizes) / sizeof(sizes[0]); p = end) {
+		double d = strtod(p, &end);
+
+		if (end == p || d < 1.0) {
+			usage(argv[0]);
+			return 1;
+		}
+		sizes[nsizes++] = (size_t)d;
+		if (*end == ',')
+			end++;
+	}
+
+	printf("%-9s %-11s %10s %-6s %12s %8s %8s %8s %10s %8s\n",
+	       "backend", "stream", "n", "phase", "ops/s", "p50ns", "p99ns", "p999ns", "peakKiB", "B/entry");
+	for (s = 0; s < nsizes; s++) {
+		for (w = 0; w < NUM_STREAMS; w++) {
+			if (!selected(wlist, streams[w].name))
+				continue;
+			for (b = 0; b < NUM_BACKENDS; b++) {
+				if (selected(blist, backends[b].name))
+					bench_run(&backends[b], &streams[w], sizes[s], timeout);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,586 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: concurrent chained hash-table, striped writer locks and
+         lock-free readers protected by epochs
+   Ref:  [Herlihy 2008], [McKenney 2001], [Fraser 2004].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <classic/chashtable.h>
+#include <classic/epoch.h>
+
+#include "hashtable.h"
+#include "allocator.h"
+#include "lock.h"
+
+/*
+ * Readers find the bucket array through ht->table and walk its chains
+ * without locking, inside an epoch critical section.  Writers lock the
+ * stripe owning the bucket (bucket index modulo HT_STRIPES) and publish a
+ * new node with a release store once it is fully built; unlinked nodes are
+ * retired to the epoch code rather than freed.
+ *
+ * A resize holds every stripe, copies the live nodes into a new bucket
+ * array and publishes it; readers still on the old array see a consistent
+ * snapshot until it is reclaimed.  Each stripe counts its own entries and
+ * asks for a resize when its buckets pass the load factor, so writers
+ * never share a counter.
+ */
+#define HT_STRIPES			64	// a power of two
+#define HT_STRIPE_PAD			64
+
+#define LOADFACTOR_NUMERATOR		2
+#define LOADFACTOR_DENOMINATOR		3
+
+struct ccl_cht_table_t {
+	size_t size;
+	ccl_cht_node *buckets[];
+};
+
+struct ccl_cht_stripe_t {
+	ccl_lock lock;
+	size_t count;			// entries in the buckets of this stripe
+	size_t limit;			// count at which to ask for a resize
+	char pad[HT_STRIPE_PAD];	// keep the next lock off this cache line
+};
+
+#define ccl_cht_stripe(ht,hn)		(&(ht)->stripes[(hn) & (HT_STRIPES - 1)])
+
+static ccl_cht_node *ccl_cht_node_alloc(ccl_cht *ht, void *k, void *v, uint64_t hash)
+{
+	ccl_cht_node *node;
+
+	node = ccl_mem_alloc(ht->allocator, sizeof(*node));
+	if (node == NULL)
+		return NULL;
+	node->next = NULL;
+	node->key = k;
+	node->value = v;
+	node->hash = hash;
+	return node;
+}
+
+static void ccl_cht_node_dealloc(ccl_cht *ht, ccl_cht_node *node)
+{
+	if (ht->kfree != NULL)
+		ht->kfree(node->key);
+	if (ht->vfree != NULL)
+		ht->vfree(node->value);
+	ccl_mem_free(ht->allocator, node);
+	return;
+}
+
+static struct ccl_cht_table_t *ccl_cht_table_alloc(ccl_cht *ht, size_t size)
+{
+	struct ccl_cht_table_t *t;
+
+	if (size > (SIZE_MAX - sizeof(*t)) / sizeof(t->buckets[0]))
+		return NULL;
+	t = ccl_mem_alloc(ht->allocator, sizeof(*t) + size * sizeof(t->buckets[0]));
+	if (t == NULL)
+		return NULL;
+	t->size = size;
+	memset(t->buckets, 0, size * sizeof(t->buckets[0]));
+	return t;
+}
+
+// epoch callbacks: a deleted node, a cleared chain, a table replaced by a resize
+static void ccl_cht_node_release(void *ctx, void *p)
+{
+	ccl_cht_node_dealloc(ctx, p);
+	return;
+}
+
+static void ccl_cht_chain_release(void *ctx, void *p)
+{
+	ccl_cht_node *node, *next;
+
+	for (node = p; node != NULL; node = next) {
+		next = node->next;
+		ccl_cht_node_dealloc(ctx, node);
+	}
+	return;
+}
+
+// the nodes of a replaced table are copies, keys and values live on
+static void ccl_cht_table_release(void *ctx, void *p)
+{
+	ccl_cht *ht = ctx;
+	struct ccl_cht_table_t *t = p;
+	ccl_cht_node *node, *next;
+	size_t i;
+
+	for (i = 0; i < t->size; i++) {
+		for (node = t->buckets[i]; node != NULL; node = next) {
+			next = node->next;
+			ccl_mem_free(ht->allocator, node);
+		}
+	}
+	ccl_mem_free(ht->allocator, t);
+	return;
+}
+
+static void ccl_cht_retire(ccl_cht *ht, void *p, ccl_epoch_cb cb)
+{
+	if (!ccl_epoch_retire_ex(p, cb, ht)) {
+		ccl_epoch_synchronize();	// nowhere to defer it to, wait for the readers
+		cb(ht, p);
+	}
+	return;
+}
+
+/* stripe limits for a table of size buckets */
+static void ccl_cht_set_limits(ccl_cht *ht, size_t size)
+{
+	size_t i, nb;
+
+	for (i = 0; i < HT_STRIPES; i++) {
+		nb = size / HT_STRIPES + (i < size % HT_STRIPES);
+		ht->stripes[i].limit = nb * LOADFACTOR_NUMERATOR / LOADFACTOR_DENOMINATOR + 1;
+	}
+	return;
+}
+
+static ccl_cht *ccl_cht_create(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, ccl_hash64_cb hash64_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	ccl_cht *ht;
+	unsigned i;
+
+	if (cmp_cb == NULL || (hash_cb == NULL && hash64_cb == NULL))
+		return NULL;
+	ht = ccl_mem_alloc(allocator, sizeof(*ht));
+	if (ht == NULL)
+		return NULL;
+	ht->allocator = allocator;
+	ht->cmp = cmp_cb;
+	ht->kfree = kfree_cb;
+	ht->vfree = vfree_cb;
+	ht->hash = hash_cb;
+	ht->hash64 = hash64_cb;
+	ht->flags = flags & CCL_HT_POW2;
+	ht->table = ccl_cht_table_alloc(ht, ccl_ht_size_geq(size, flags));
+	if (ht->table == NULL)
+		goto err;
+	ht->stripes = ccl_mem_calloc(allocator, HT_STRIPES, sizeof(*ht->stripes));
+	if (ht->stripes == NULL)
+		goto err_table;
+	for (i = 0; i < HT_STRIPES; i++) {
+		if (!ccl_lock_init(&ht->stripes[i].lock))
+			goto err_locks;
+	}
+	ccl_cht_set_limits(ht, ht->table->size);
+	return ht;
+err_locks:
+	while (i-- > 0)
+		ccl_lock_destroy(&ht->stripes[i].lock);
+	ccl_mem_free(allocator, ht->stripes);
+err_table:
+	ccl_mem_free(allocator, ht->table);
+err:
+	ccl_mem_free(allocator, ht);
+	return NULL;
+}
+
+ccl_cht *ccl_cht_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	if (hash_cb == NULL)
+		return NULL;
+	return ccl_cht_create(cmp_cb, kfree_cb, vfree_cb, hash_cb, NULL, size, flags, allocator);
+}
+
+ccl_cht *ccl_cht_new64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	if (hash_cb == NULL)
+		return NULL;
+	return ccl_cht_create(cmp_cb, kfree_cb, vfree_cb, NULL, hash_cb, size, flags, allocator);
+}
+
+ccl_cht *ccl_cht_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size)
+{
+	return ccl_cht_new_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, 0, NULL);
+}
+
+static void ccl_cht_lock_all(ccl_cht *ht)
+{
+	unsigned i;
+
+	for (i = 0; i < HT_STRIPES; i++)
+		ccl_lock_acquire(&ht->stripes[i].lock);
+	return;
+}
+
+static void ccl_cht_unlock_all(ccl_cht *ht)
+{
+	unsigned i;
+
+	for (i = HT_STRIPES; i-- > 0; )
+		ccl_lock_release(&ht->stripes[i].lock);
+	return;
+}
+
+size_t ccl_cht_count(ccl_cht *ht)
+{
+	size_t count;
+	unsigned i;
+
+	count = 0;
+	for (i = 0; i < HT_STRIPES; i++) {
+		ccl_lock_acquire(&ht->stripes[i].lock);
+		count += ht->stripes[i].count;
+		ccl_lock_release(&ht->stripes[i].lock);
+	}
+	return count;
+}
+
+/*
+ * May run concurrently with readers, which keep seeing the old chains, and
+ * with writers: an entry inserted while clear runs may survive it.  Each
+ * bucket is emptied under its stripe lock alone and its chain retired once
+ * the lock is dropped, as retiring may have to wait for a grace period
+ * that a writer blocked on the lock would never let end.
+ */
+size_t ccl_cht_clear(ccl_cht *ht)
+{
+	struct ccl_cht_table_t *t;
+	struct ccl_cht_stripe_t *s;
+	ccl_cht_node *chain, *node;
+	size_t i, size, count;
+
+	count = 0;
+	size = 1;
+	t = NULL;
+	for (i = 0; i < size; i++) {
+		s = ccl_cht_stripe(ht, i);
+		ccl_lock_acquire(&s->lock);
+		// tables only grow, so the size also tells a new table at t's address
+		if (ht->table != t || t->size != size) {
+			// first pass, or a resize replaced the table: start over
+			t = ht->table;
+			size = t->size;
+			ccl_lock_release(&s->lock);
+			i = (size_t)-1;
+			continue;
+		}
+		chain = t->buckets[i];
+		for (node = chain; node != NULL; node = node->next) {
+			s->count--;
+			count++;
+		}
+		__atomic_store_n(&t->buckets[i], NULL, __ATOMIC_RELEASE);
+		ccl_lock_release(&s->lock);
+		if (chain != NULL)
+			ccl_cht_retire(ht, chain, ccl_cht_chain_release);
+	}
+	return count;
+}
+
+/* no other thread may use the table any more */
+void ccl_cht_free(ccl_cht *ht)
+{
+	ccl_cht_node *node, *next;
+	size_t i;
+
+	ccl_epoch_barrier();		// retired memory refers to ht
+	for (i = 0; i < ht->table->size; i++) {
+		for (node = ht->table->buckets[i]; node != NULL; node = next) {
+			next = node->next;
+			ccl_cht_node_dealloc(ht, node);
+		}
+	}
+	for (i = 0; i < HT_STRIPES; i++)
+		ccl_lock_destroy(&ht->stripes[i].lock);
+	ccl_mem_free(ht->allocator, ht->stripes);
+	ccl_mem_free(ht->allocator, ht->table);
+	ccl_mem_free(ht->allocator, ht);
+	return;
+}
+
+/* caller is inside an epoch section */
+static ccl_cht_node *ccl_cht_search_node(ccl_cht *ht, void *k, uint64_t hash)
+{
+	struct ccl_cht_table_t *t;
+	ccl_cht_node *node;
+
+	t = __atomic_load_n(&ht->table, __ATOMIC_ACQUIRE);
+	node = __atomic_load_n(&t->buckets[ccl_ht_index(hash, t->size, ht->flags)], __ATOMIC_ACQUIRE);
+	while (node != NULL) {
+		if (hash < node->hash)
+			return NULL;
+		if (hash == node->hash && !ht->cmp(k, node->key))
+			break;
+		node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+	}
+	return node;
+}
+
+bool ccl_cht_select(ccl_cht *ht, void *k, void **v)
+{
+	ccl_cht_node *node;
+
+	if (k == NULL || !ccl_epoch_enter())
+		return false;
+	node = ccl_cht_search_node(ht, k, ccl_ht_hash(ht->hash, ht->hash64, k, ht->flags));
+	if (node != NULL)
+		*v = node->value;
+	ccl_epoch_exit();
+	return (node != NULL);
+}
+
+/*
+ * Lock the stripe of hash's bucket in the current table.  The caller is
+ * inside an epoch section, so the table read here cannot be reclaimed
+ * before the lock shows whether a resize replaced it.
+ */
+static struct ccl_cht_table_t *ccl_cht_lock(ccl_cht *ht, uint64_t hash, size_t *hn)
+{
+	struct ccl_cht_table_t *t;
+
+	for (;;) {
+		t = __atomic_load_n(&ht->table, __ATOMIC_ACQUIRE);
+		*hn = ccl_ht_index(hash, t->size, ht->flags);
+		ccl_lock_acquire(&ccl_cht_stripe(ht, *hn)->lock);
+		if (ht->table == t)
+			return t;
+		ccl_lock_release(&ccl_cht_stripe(ht, *hn)->lock);
+	}
+}
+
+/* copy of every node of t into a new table of nsize buckets, NULL on failure */
+static struct ccl_cht_table_t *ccl_cht_copy(ccl_cht *ht, struct ccl_cht_table_t *t, size_t nsize)
+{
+	struct ccl_cht_table_t *nt;
+	ccl_cht_node *node, *copy, **pnode;
+	size_t i, hn;
+
+	nt = ccl_cht_table_alloc(ht, nsize);
+	if (nt == NULL)
+		return NULL;
+	for (i = 0; i < HT_STRIPES; i++)
+		ht->stripes[i].count = 0;
+	for (i = 0; i < t->size; i++) {
+		for (node = t->buckets[i]; node != NULL; node = node->next) {
+			copy = ccl_cht_node_alloc(ht, node->key, node->value, node->hash);
+			if (copy == NULL)
+				goto err;
+			hn = ccl_ht_index(node->hash, nt->size, ht->flags);
+			for (pnode = &nt->buckets[hn]; *pnode != NULL; pnode = &(*pnode)->next) {
+				if (copy->hash < (*pnode)->hash)
+					break;
+			}
+			copy->next = *pnode;
+			*pnode = copy;
+			ccl_cht_stripe(ht, hn)->count++;
+		}
+	}
+	return nt;
+err:
+	// restore the counts of t and drop the partial copy
+	for (i = 0; i < HT_STRIPES; i++)
+		ht->stripes[i].count = 0;
+	for (i = 0; i < t->size; i++) {
+		for (node = t->buckets[i]; node != NULL; node = node->next)
+			ccl_cht_stripe(ht, i)->count++;
+	}
+	ccl_cht_table_release(ht, nt);
+	return NULL;
+}
+
+/* grow the table t if a stripe ran over its limit and t is still current */
+static void ccl_cht_resize(ccl_cht *ht, struct ccl_cht_table_t *t, size_t hn)
+{
+	struct ccl_cht_table_t *nt;
+	struct ccl_cht_stripe_t *s;
+	size_t i, count, nsize;
+
+	ccl_cht_lock_all(ht);
+	s = ccl_cht_stripe(ht, hn);
+	if (ht->table != t || s->count < s->limit)
+		goto out;
+	count = 0;
+	for (i = 0; i < HT_STRIPES; i++)
+		count += ht->stripes[i].count;
+	nsize = ccl_ht_size_geq(t->size + 1, ht->flags);
+	if (LOADFACTOR_DENOMINATOR * count < LOADFACTOR_NUMERATOR * t->size || nsize == t->size) {
+		// one crowded stripe in a light table: the hash is poor, not the size
+		s->limit = 2 * s->count;
+		goto out;
+	}
+	nt = ccl_cht_copy(ht, t, nsize);
+	if (nt == NULL)		// hash table is unchanged
+		goto out;
+	ccl_cht_set_limits(ht, nsize);
+	__atomic_store_n(&ht->table, nt, __ATOMIC_RELEASE);
+	ccl_cht_unlock_all(ht);
+	ccl_cht_retire(ht, t, ccl_cht_table_release);
+	return;
+out:
+	ccl_cht_unlock_all(ht);
+	return;
+}
+
+/*
+ * *pv is set as by ccl_ht1_insert, but the slot belongs to a node that a
+ * concurrent delete or a resize may retire: only use it while no other
+ * thread modifies the table.
+ */
+bool ccl_cht_insert(ccl_cht *ht, void *k, void *v, void **pv)
+{
+	struct ccl_cht_table_t *t;
+	struct ccl_cht_stripe_t *s;
+	ccl_cht_node *node, **pnode;
+	uint64_t hash;
+	size_t hn;
+	bool grow;
+
+	*pv = NULL;
+	if (k == NULL || !ccl_epoch_enter())
+		return false;
+	hash = ccl_ht_hash(ht->hash, ht->hash64, k, ht->flags);
+	t = ccl_cht_lock(ht, hash, &hn);
+	s = ccl_cht_stripe(ht, hn);
+	for (pnode = &t->buckets[hn]; *pnode != NULL; pnode = &(*pnode)->next) {
+		node = *pnode;
+		if (hash < node->hash)
+			break;
+		if (hash == node->hash && !ht->cmp(k, node->key)) {
+			*pv = &node->value;
+			ccl_lock_release(&s->lock);
+			ccl_epoch_exit();
+			return false;
+		}
+	}
+	node = ccl_cht_node_alloc(ht, k, v, hash);
+	if (node == NULL) {
+		ccl_lock_release(&s->lock);
+		ccl_epoch_exit();
+		return false;
+	}
+	node->next = *pnode;
+	__atomic_store_n(pnode, node, __ATOMIC_RELEASE);
+	*pv = &node->value;
+	grow = (++s->count >= s->limit);
+	ccl_lock_release(&s->lock);
+	ccl_epoch_exit();
+	if (grow)
+		ccl_cht_resize(ht, t, hn);
+	return true;
+}
+
+bool ccl_cht_delete(ccl_cht *ht, void *key)
+{
+	struct ccl_cht_table_t *t;
+	struct ccl_cht_stripe_t *s;
+	ccl_cht_node *node, **pnode;
+	uint64_t hash;
+	size_t hn;
+
+	if (key == NULL || !ccl_epoch_enter())
+		return false;
+	hash = ccl_ht_hash(ht->hash, ht->hash64, key, ht->flags);
+	t = ccl_cht_lock(ht, hash, &hn);
+	s = ccl_cht_stripe(ht, hn);
+	for (pnode = &t->buckets[hn]; (node = *pnode) != NULL; pnode = &node->next) {
+		if (hash < node->hash)
+			break;
+		if (hash == node->hash && !ht->cmp(key, node->key)) {
+			// readers on node still find the rest of the chain through it
+			__atomic_store_n(pnode, node->next, __ATOMIC_RELEASE);
+			s->count--;
+			ccl_lock_release(&s->lock);
+			ccl_epoch_exit();
+			ccl_cht_retire(ht, node, ccl_cht_node_release);
+			return true;
+		}
+	}
+	ccl_lock_release(&s->lock);
+	ccl_epoch_exit();
+	return false;
+}
+
+/* sees a snapshot of each chain, cb must not free the table */
+bool ccl_cht_foreach(ccl_cht *ht, ccl_dforeach_cb cb, void *user)
+{
+	struct ccl_cht_table_t *t;
+	ccl_cht_node *node;
+	size_t i;
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = true;
+	t = __atomic_load_n(&ht->table, __ATOMIC_ACQUIRE);
+	for (i = 0; i < t->size && ret; i++) {
+		node = __atomic_load_n(&t->buckets[i], __ATOMIC_ACQUIRE);
+		while (node != NULL && ret) {
+			ret = cb(node->key, node->value, user);
+			node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+		}
+	}
+	ccl_epoch_exit();
+	return ret;
+}
+
+static struct ccl_map_ops map_ops = {
+	.free		= (ccl_map_free_cb)ccl_cht_free,
+	.clear		= (ccl_map_clear_cb)ccl_cht_clear,
+	.select		= (ccl_map_select_cb)ccl_cht_select,
+	.insert		= (ccl_map_insert_cb)ccl_cht_insert,
+	.delete		= (ccl_map_delete_cb)ccl_cht_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_cht_foreach,
+};
+
+static ccl_map *ccl_umap_cht_wrap(ccl_cht *ht, const ccl_allocator *allocator)
+{
+	ccl_map *map;
+
+	if (ht == NULL)
+		return NULL;
+	map = ccl_mem_alloc(allocator, sizeof(*map));
+	if (map == NULL)
+		goto err;
+	map->obj = ht;
+	map->ops = &map_ops;
+	map->allocator = allocator;
+	map->sorted = false;
+	return map;
+err:
+	ccl_cht_free(ht);
+	return NULL;
+}
+
+ccl_map *ccl_umap_cht_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	return ccl_umap_cht_wrap(ccl_cht_new_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, flags, allocator), allocator);
+}
+
+ccl_map *ccl_umap_cht_64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	return ccl_umap_cht_wrap(ccl_cht_new64(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, flags, allocator), allocator);
+}
+
+ccl_map *ccl_umap_cht(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size)
+{
+	return ccl_umap_cht_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, 0, NULL);
+}
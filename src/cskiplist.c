@@ -0,0 +1,502 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: lock-free skiplist with marked links and epoch reclamation
+   Ref:  [Fraser 2004], [Herlihy 2008].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <classic/cskiplist.h>
+#include <classic/epoch.h>
+
+#include "allocator.h"
+
+/*
+ * A delete first sets the low bit of every link of the node, top level
+ * first; whoever marks link[0] owns the delete.  Marked links never change
+ * again, and writers searching the list snip marked nodes out of each
+ * level with a CAS on the predecessor, restarting when that fails.
+ * Readers only skip marked nodes, so they never write shared memory.
+ *
+ * An insert links link[0] first, which makes the entry visible, and the
+ * upper levels after it; a delete may overtake it at any point.  The node
+ * is retired only when both are done with it (NODE_INSERTED and
+ * NODE_DELETED in state), after a final search has snipped it from every
+ * level it reached.
+ *
+ * When the epoch code has no memory to queue a node, waiting for a grace
+ * period instead is not an option: the caller may be inside a section of
+ * its own.  The node goes on list->deferred, linked through the fields
+ * its insert and delete no longer need, and is handed to the epoch code
+ * by the next retire that succeeds, or freed by ccl_cskiplist_free().
+ */
+#define CSKIP_MAX_LINK			32
+
+#define NODE_INSERTED			0x1
+#define NODE_DELETED			0x2
+
+#define ccl_cskip_marked(p)		((uintptr_t)(p) & 1)
+#define ccl_cskip_mark(p)		((ccl_cskipnode *)((uintptr_t)(p) | 1))
+#define ccl_cskip_ptr(p)		((ccl_cskipnode *)((uintptr_t)(p) & ~(uintptr_t)1))
+#define ccl_cskip_load(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ccl_cskip_cas(p,o,n)		__atomic_compare_exchange_n((p), (o), (n), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+static ccl_cskipnode *ccl_cskipnode_alloc(ccl_cskiplist *list, void *k, void *v, unsigned link_count)
+{
+	ccl_cskipnode *node;
+
+	node = ccl_mem_alloc(list->allocator, sizeof(*node) + sizeof(node->link[0]) * link_count);
+	if (node == NULL)
+		return NULL;
+	node->key = k;
+	node->value = v;
+	node->u.n.link_count = link_count;
+	node->u.n.state = 0;
+	memset(node->link, 0, sizeof(node->link[0]) * link_count);
+	return node;
+}
+
+static void ccl_cskipnode_dealloc(ccl_cskiplist *list, ccl_cskipnode *node)
+{
+	if (list->kfree != NULL)
+		list->kfree(node->key);
+	if (list->vfree != NULL)
+		list->vfree(node->value);
+	ccl_mem_free(list->allocator, node);
+	return;
+}
+
+static void ccl_cskipnode_release(void *ctx, void *p)
+{
+	ccl_cskipnode_dealloc(ctx, p);
+	return;
+}
+
+static void ccl_cskipnode_defer(ccl_cskiplist *list, ccl_cskipnode *node)
+{
+	node->u.deferred = __atomic_load_n(&list->deferred, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&list->deferred, &node->u.deferred, node, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	return;
+}
+
+/* record that the insert or the delete of node is over, the later one retires it */
+static void ccl_cskipnode_done(ccl_cskiplist *list, ccl_cskipnode *node, unsigned what)
+{
+	ccl_cskipnode *next;
+
+	if ((__atomic_fetch_or(&node->u.n.state, what, __ATOMIC_ACQ_REL) | what) != (NODE_INSERTED | NODE_DELETED))
+		return;
+	if (!ccl_epoch_retire_ex(node, ccl_cskipnode_release, list)) {
+		ccl_cskipnode_defer(list, node);
+		return;
+	}
+	if (__atomic_load_n(&list->deferred, __ATOMIC_RELAXED) == NULL)
+		return;
+	// there is memory again, retry what could not be queued before
+	node = __atomic_exchange_n(&list->deferred, NULL, __ATOMIC_ACQUIRE);
+	for (; node != NULL; node = next) {
+		next = node->u.deferred;
+		if (!ccl_epoch_retire_ex(node, ccl_cskipnode_release, list))
+			ccl_cskipnode_defer(list, node);
+	}
+	return;
+}
+
+ccl_cskiplist *ccl_cskiplist_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link, unsigned flags, const ccl_allocator *allocator)
+{
+	ccl_cskiplist *list;
+
+	(void)flags;
+	if (cmp_cb == NULL)
+		return NULL;
+	if (max_link == 0 || max_link > CSKIP_MAX_LINK)
+		max_link = CSKIP_MAX_LINK;
+	list = ccl_mem_alloc(allocator, sizeof(*list));
+	if (list == NULL)
+		return NULL;
+	list->allocator = allocator;
+	list->cmp = cmp_cb;
+	list->kfree = kfree_cb;
+	list->vfree = vfree_cb;
+	list->max_link = max_link;
+	list->top_link = 1;
+	list->deferred = NULL;
+	list->head = ccl_cskipnode_alloc(list, NULL, NULL, max_link);
+	if (list->head == NULL)
+		goto err;
+	return list;
+err:
+	ccl_mem_free(allocator, list);
+	return NULL;
+}
+
+ccl_cskiplist *ccl_cskiplist_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link)
+{
+	return ccl_cskiplist_new_ex(cmp_cb, kfree_cb, vfree_cb, max_link, 0, NULL);
+}
+
+/* no other thread may use the list any more */
+void ccl_cskiplist_free(ccl_cskiplist *list)
+{
+	ccl_cskipnode *node, *next;
+
+	ccl_epoch_barrier();		// retired nodes refer to list
+	for (node = ccl_cskip_ptr(list->head->link[0]); node != NULL; node = next) {
+		next = ccl_cskip_ptr(node->link[0]);
+		ccl_cskipnode_dealloc(list, node);
+	}
+	for (node = list->deferred; node != NULL; node = next) {
+		next = node->u.deferred;
+		ccl_cskipnode_dealloc(list, node);
+	}
+	ccl_mem_free(list->allocator, list->head);
+	ccl_mem_free(list->allocator, list);
+	return;
+}
+
+static unsigned ccl_cskiplist_height(ccl_cskiplist *list)
+{
+	static __thread uint64_t seed;
+	unsigned height;
+	uint64_t r;
+
+	if (seed == 0)
+		seed = ((uintptr_t)&seed * 0x9e3779b97f4a7c15ULL) | 1;
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	for (height = 1, r = seed; height < list->max_link && (r & 3) == 0; r >>= 2)
+		height++;
+	return height;
+}
+
+/*
+ * Writer search: preds[i] and succs[i] bracket k on every level in use,
+ * with marked nodes on the way snipped out.  True if succs[0] holds k.
+ */
+static bool ccl_cskiplist_find(ccl_cskiplist *list, const void *k, ccl_cskipnode **preds, ccl_cskipnode **succs)
+{
+	ccl_cskipnode *pred, *curr, *next;
+	unsigned i;
+	int ret;
+
+retry:
+	pred = list->head;
+	ret = 1;
+	for (i = __atomic_load_n(&list->top_link, __ATOMIC_ACQUIRE); i-- > 0; ) {
+		curr = ccl_cskip_ptr(ccl_cskip_load(&pred->link[i]));
+		for (ret = 1; curr != NULL; pred = curr, curr = next) {
+			next = ccl_cskip_load(&curr->link[i]);
+			while (ccl_cskip_marked(next)) {
+				if (!ccl_cskip_cas(&pred->link[i], &curr, ccl_cskip_ptr(next)))
+					goto retry;
+				curr = ccl_cskip_ptr(next);
+				if (curr == NULL)
+					break;
+				next = ccl_cskip_load(&curr->link[i]);
+			}
+			if (curr == NULL)
+				break;
+			ret = list->cmp(curr->key, k);
+			if (ret >= 0)
+				break;
+		}
+		preds[i] = pred;
+		succs[i] = curr;
+	}
+	return (succs[0] != NULL && ret == 0);
+}
+
+/* reader search: first live node with key >= k, or > k when strict */
+static ccl_cskipnode *ccl_cskiplist_bound_node(ccl_cskiplist *list, const void *k, bool strict)
+{
+	ccl_cskipnode *pred, *curr, *next;
+	unsigned i;
+	int ret;
+
+	pred = list->head;
+	curr = NULL;
+	for (i = __atomic_load_n(&list->top_link, __ATOMIC_ACQUIRE); i-- > 0; ) {
+		for (curr = ccl_cskip_ptr(ccl_cskip_load(&pred->link[i])); curr != NULL; pred = curr, curr = next) {
+			next = ccl_cskip_load(&curr->link[i]);
+			while (ccl_cskip_marked(next)) {
+				curr = ccl_cskip_ptr(next);
+				if (curr == NULL)
+					break;
+				next = ccl_cskip_load(&curr->link[i]);
+			}
+			if (curr == NULL)
+				break;
+			ret = list->cmp(curr->key, k);
+			if (ret > 0 || (ret == 0 && !strict))
+				break;
+		}
+	}
+	return curr;
+}
+
+/* first live node after node (the head for the first one) */
+static ccl_cskipnode *ccl_cskiplist_next(ccl_cskipnode *node)
+{
+	ccl_cskipnode *next;
+
+	node = ccl_cskip_ptr(ccl_cskip_load(&node->link[0]));
+	while (node != NULL) {
+		next = ccl_cskip_load(&node->link[0]);
+		if (!ccl_cskip_marked(next))
+			break;
+		node = ccl_cskip_ptr(next);
+	}
+	return node;
+}
+
+bool ccl_cskiplist_select(ccl_cskiplist *list, void *k, void **v)
+{
+	ccl_cskipnode *node;
+	bool found;
+
+	if (k == NULL || !ccl_epoch_enter())
+		return false;
+	node = ccl_cskiplist_bound_node(list, k, false);
+	found = (node != NULL && !list->cmp(node->key, k));
+	if (found)
+		*v = node->value;
+	ccl_epoch_exit();
+	return found;
+}
+
+/*
+ * *pv is set as by ccl_skiplist_insert, but a concurrent delete may retire
+ * the node holding it: only use it while no other thread modifies the list.
+ */
+bool ccl_cskiplist_insert(ccl_cskiplist *list, void *k, void *v, void **pv)
+{
+	ccl_cskipnode *preds[CSKIP_MAX_LINK], *succs[CSKIP_MAX_LINK];
+	ccl_cskipnode *node, *next, *expected;
+	unsigned i, height, top;
+
+	*pv = NULL;
+	if (k == NULL || !ccl_epoch_enter())
+		return false;
+	height = ccl_cskiplist_height(list);
+	top = __atomic_load_n(&list->top_link, __ATOMIC_RELAXED);
+	while (top < height && !__atomic_compare_exchange_n(&list->top_link, &top, height, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	node = NULL;
+	for (;;) {
+		if (ccl_cskiplist_find(list, k, preds, succs)) {
+			*pv = &succs[0]->value;
+			ccl_epoch_exit();
+			if (node != NULL)
+				ccl_mem_free(list->allocator, node);	// never published
+			return false;
+		}
+		if (node == NULL) {
+			node = ccl_cskipnode_alloc(list, k, v, height);
+			if (node == NULL) {
+				ccl_epoch_exit();
+				return false;
+			}
+		}
+		for (i = 0; i < height; i++)
+			node->link[i] = succs[i];
+		expected = succs[0];
+		if (ccl_cskip_cas(&preds[0]->link[0], &expected, node))
+			break;
+	}
+	*pv = &node->value;
+
+	for (i = 1; i < height; i++) {
+		for (;;) {
+			next = ccl_cskip_load(&node->link[i]);
+			if (ccl_cskip_marked(next))
+				goto done;		// a delete got there first
+			if (next != succs[i] && !ccl_cskip_cas(&node->link[i], &next, succs[i]))
+				continue;
+			expected = succs[i];
+			if (ccl_cskip_cas(&preds[i]->link[i], &expected, node))
+				break;
+			ccl_cskiplist_find(list, k, preds, succs);
+			if (succs[0] != node)
+				goto done;
+		}
+	}
+done:
+	// levels linked after the delete's last search must be snipped again
+	if (ccl_cskip_marked(ccl_cskip_load(&node->link[0])))
+		ccl_cskiplist_find(list, k, preds, succs);
+	ccl_epoch_exit();
+	ccl_cskipnode_done(list, node, NODE_INSERTED);
+	return true;
+}
+
+bool ccl_cskiplist_delete(ccl_cskiplist *list, void *key)
+{
+	ccl_cskipnode *preds[CSKIP_MAX_LINK], *succs[CSKIP_MAX_LINK];
+	ccl_cskipnode *node, *next;
+	unsigned i;
+
+	if (key == NULL || !ccl_epoch_enter())
+		return false;
+	if (!ccl_cskiplist_find(list, key, preds, succs)) {
+		ccl_epoch_exit();
+		return false;
+	}
+	node = succs[0];
+	for (i = node->u.n.link_count; i-- > 1; ) {
+		next = ccl_cskip_load(&node->link[i]);
+		while (!ccl_cskip_marked(next) && !ccl_cskip_cas(&node->link[i], &next, ccl_cskip_mark(next)))
+			;
+	}
+	next = ccl_cskip_load(&node->link[0]);
+	for (;;) {
+		if (ccl_cskip_marked(next)) {
+			ccl_epoch_exit();	// deleted by another thread
+			return false;
+		}
+		if (ccl_cskip_cas(&node->link[0], &next, ccl_cskip_mark(next)))
+			break;
+	}
+	ccl_cskiplist_find(list, key, preds, succs);
+	ccl_epoch_exit();
+	ccl_cskipnode_done(list, node, NODE_DELETED);
+	return true;
+}
+
+/*
+ * Deletes entry by entry, so it may run concurrently with other
+ * operations; each first key is only held on to for its own delete.
+ */
+size_t ccl_cskiplist_clear(ccl_cskiplist *list)
+{
+	ccl_cskipnode *node;
+	size_t count;
+	bool deleted;
+
+	for (count = 0; ; count += deleted) {
+		if (!ccl_epoch_enter())
+			break;
+		node = ccl_cskiplist_next(list->head);
+		deleted = (node != NULL && ccl_cskiplist_delete(list, node->key));
+		ccl_epoch_exit();
+		if (node == NULL)
+			break;
+	}
+	return count;
+}
+
+bool ccl_cskiplist_lower_bound(ccl_cskiplist *list, const void *k, void **key, void **value)
+{
+	ccl_cskipnode *node;
+
+	if (k == NULL || !ccl_epoch_enter())
+		return false;
+	node = ccl_cskiplist_bound_node(list, k, false);
+	if (node != NULL) {
+		*key = node->key;
+		*value = node->value;
+	}
+	ccl_epoch_exit();
+	return (node != NULL);
+}
+
+bool ccl_cskiplist_upper_bound(ccl_cskiplist *list, const void *k, void **key, void **value)
+{
+	ccl_cskipnode *node;
+
+	if (k == NULL || !ccl_epoch_enter())
+		return false;
+	node = ccl_cskiplist_bound_node(list, k, true);
+	if (node != NULL) {
+		*key = node->key;
+		*value = node->value;
+	}
+	ccl_epoch_exit();
+	return (node != NULL);
+}
+
+/* entries with lo <= key < hi in order, a NULL bound is open; cb must not free the list */
+bool ccl_cskiplist_range_foreach(ccl_cskiplist *list, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	ccl_cskipnode *node;
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = true;
+	node = (lo != NULL ? ccl_cskiplist_bound_node(list, lo, false) : ccl_cskiplist_next(list->head));
+	for (; node != NULL; node = ccl_cskiplist_next(node)) {
+		if (hi != NULL && list->cmp(node->key, hi) >= 0)
+			break;
+		if (!cb(node->key, node->value, user)) {
+			ret = false;
+			break;
+		}
+	}
+	ccl_epoch_exit();
+	return ret;
+}
+
+bool ccl_cskiplist_foreach(ccl_cskiplist *list, ccl_dforeach_cb cb, void *user)
+{
+	return ccl_cskiplist_range_foreach(list, NULL, NULL, cb, user);
+}
+
+static struct ccl_map_ops map_ops = {
+	.free		= (ccl_map_free_cb)ccl_cskiplist_free,
+	.clear		= (ccl_map_clear_cb)ccl_cskiplist_clear,
+	.select		= (ccl_map_select_cb)ccl_cskiplist_select,
+	.insert		= (ccl_map_insert_cb)ccl_cskiplist_insert,
+	.delete		= (ccl_map_delete_cb)ccl_cskiplist_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_cskiplist_foreach,
+	.lower_bound	= (ccl_map_bound_cb)ccl_cskiplist_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_cskiplist_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_cskiplist_range_foreach,
+};
+
+ccl_map *ccl_smap_cskiplist_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link, unsigned flags, const ccl_allocator *allocator)
+{
+	ccl_map *map;
+
+	map = ccl_mem_alloc(allocator, sizeof(*map));
+	if (map == NULL)
+		return NULL;
+	map->obj = ccl_cskiplist_new_ex(cmp_cb, kfree_cb, vfree_cb, max_link, flags, allocator);
+	if (map->obj == NULL)
+		goto err;
+	map->ops = &map_ops;
+	map->allocator = allocator;
+	map->sorted = true;
+	return map;
+err:
+	ccl_mem_free(allocator, map);
+	return NULL;
+}
+
+ccl_map *ccl_smap_cskiplist(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned max_link)
+{
+	return ccl_smap_cskiplist_ex(cmp_cb, kfree_cb, vfree_cb, max_link, 0, NULL);
+}
@@ -0,0 +1,444 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: epoch based memory reclamation
+   Ref:  [Fraser 2004], [Hart 2007].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <classic/epoch.h>
+
+/*
+ * The global epoch advances once every thread inside a critical section
+ * has observed it, so memory retired in epoch e can no longer be reached
+ * by any reader once the epoch is e + 2.  Each thread keeps what it retired
+ * in a FIFO bag tagged with the epoch of retirement; every EPOCH_BATCH
+ * retires it tries to advance the epoch and runs the callbacks that became
+ * safe, unless the background reclaimer does that for all threads.
+ * Records of exited threads are reused along with their bags.
+ */
+#define EPOCH_BATCH		64
+#define EPOCH_RUN		32	// callbacks taken from a bag per lock hold
+
+struct ccl_epoch_entry {
+	void *p;
+	ccl_epoch_cb cb;		// NULL for a plain ccl_epoch_retire()
+	union {
+		void *ctx;
+		ccl_free_cb free;
+	} arg;
+	unsigned long epoch;
+};
+
+typedef struct ccl_epoch_record_t {
+	unsigned long state;		// epoch << 1 | 1 inside a critical section, 0 outside
+	unsigned nest;
+	unsigned retired;		// retires since the last reclaim
+	int owned;			// record belongs to a live thread
+	char lock;			// the bag is also drained by ccl_epoch_barrier()
+	unsigned running;		// batches taken from the bag, callbacks not done yet
+	struct ccl_epoch_entry *bag;
+	size_t head;
+	size_t tail;
+	size_t cap;
+	struct ccl_epoch_record_t *next;
+} ccl_epoch_record;
+
+static unsigned long ccl_epoch_global;
+static ccl_epoch_record *ccl_epoch_records;
+static __thread ccl_epoch_record *ccl_epoch_self;
+static bool ccl_epoch_background;		// the reclaimer thread is running
+
+static void ccl_epoch_relax(void)
+{
+#ifdef HAVE_PTHREAD_H
+	sched_yield();
+#endif
+	return;
+}
+
+static void ccl_epoch_lock(ccl_epoch_record *rec)
+{
+	while (__atomic_test_and_set(&rec->lock, __ATOMIC_ACQUIRE))
+		ccl_epoch_relax();
+	return;
+}
+
+static void ccl_epoch_unlock(ccl_epoch_record *rec)
+{
+	__atomic_clear(&rec->lock, __ATOMIC_RELEASE);
+	return;
+}
+
+/* try to move the global epoch on, returns the epoch now in force */
+static unsigned long ccl_epoch_advance(void)
+{
+	ccl_epoch_record *rec;
+	unsigned long e, state;
+
+	e = __atomic_load_n(&ccl_epoch_global, __ATOMIC_SEQ_CST);
+	for (rec = __atomic_load_n(&ccl_epoch_records, __ATOMIC_ACQUIRE); rec != NULL; rec = rec->next) {
+		state = __atomic_load_n(&rec->state, __ATOMIC_SEQ_CST);
+		if ((state & 1) && (state >> 1) != e)
+			return e;
+	}
+	if (__atomic_compare_exchange_n(&ccl_epoch_global, &e, e + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		return e + 1;
+	return e;
+}
+
+/* run the callbacks in rec's bag retired no later than epoch */
+static void ccl_epoch_run(ccl_epoch_record *rec, unsigned long epoch)
+{
+	struct ccl_epoch_entry run[EPOCH_RUN];
+	size_t i, n;
+
+	// callbacks run unlocked, they may well retire more memory
+	do {
+		ccl_epoch_lock(rec);
+		for (n = 0; n < EPOCH_RUN && rec->head < rec->tail; n++) {
+			if (rec->bag[rec->head].epoch > epoch)
+				break;
+			run[n] = rec->bag[rec->head++];
+		}
+		if (rec->head == rec->tail)
+			rec->head = rec->tail = 0;
+		if (n > 0)
+			__atomic_add_fetch(&rec->running, 1, __ATOMIC_RELAXED);
+		ccl_epoch_unlock(rec);
+		if (n == 0)
+			break;
+		for (i = 0; i < n; i++) {
+			if (run[i].cb != NULL)
+				run[i].cb(run[i].arg.ctx, run[i].p);
+			else
+				run[i].arg.free(run[i].p);
+		}
+		// ccl_epoch_barrier() waits for this
+		__atomic_sub_fetch(&rec->running, 1, __ATOMIC_RELEASE);
+	} while (n == EPOCH_RUN);
+	return;
+}
+
+static void ccl_epoch_collect(ccl_epoch_record *rec)
+{
+	unsigned long e;
+
+	e = ccl_epoch_advance();
+	if (e >= 2)
+		ccl_epoch_run(rec, e - 2);
+	return;
+}
+
+// leaving thread: what is still in the bag goes to the next owner of the record
+static void ccl_epoch_release(void *arg)
+{
+	ccl_epoch_record *rec = arg;
+
+	rec->nest = 0;
+	__atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+	ccl_epoch_collect(rec);
+	ccl_epoch_self = NULL;
+	__atomic_store_n(&rec->owned, 0, __ATOMIC_RELEASE);
+	return;
+}
+
+#ifdef HAVE_PTHREAD_H
+static pthread_key_t ccl_epoch_key;
+static pthread_once_t ccl_epoch_once = PTHREAD_ONCE_INIT;
+static bool ccl_epoch_keyed;
+
+static void ccl_epoch_key_create(void)
+{
+	ccl_epoch_keyed = (pthread_key_create(&ccl_epoch_key, ccl_epoch_release) == 0);
+	return;
+}
+#endif
+
+static ccl_epoch_record *ccl_epoch_acquire(void)
+{
+	ccl_epoch_record *rec;
+	int owned;
+
+	for (rec = __atomic_load_n(&ccl_epoch_records, __ATOMIC_ACQUIRE); rec != NULL; rec = rec->next) {
+		owned = 0;
+		if (!__atomic_load_n(&rec->owned, __ATOMIC_RELAXED) &&
+		    __atomic_compare_exchange_n(&rec->owned, &owned, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			goto found;
+	}
+	rec = calloc(1, sizeof(*rec));
+	if (rec == NULL)
+		return NULL;
+	rec->owned = 1;
+	rec->next = __atomic_load_n(&ccl_epoch_records, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&ccl_epoch_records, &rec->next, rec, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+found:
+#ifdef HAVE_PTHREAD_H
+	pthread_once(&ccl_epoch_once, ccl_epoch_key_create);
+	if (ccl_epoch_keyed)
+		pthread_setspecific(ccl_epoch_key, rec);
+#endif
+	ccl_epoch_self = rec;
+	return rec;
+}
+
+bool ccl_epoch_register(void)
+{
+	return (ccl_epoch_self != NULL || ccl_epoch_acquire() != NULL);
+}
+
+/* give the record of the calling thread back before it exits */
+void ccl_epoch_unregister(void)
+{
+	ccl_epoch_record *rec = ccl_epoch_self;
+
+	if (rec == NULL)
+		return;
+#ifdef HAVE_PTHREAD_H
+	if (ccl_epoch_keyed)
+		pthread_setspecific(ccl_epoch_key, NULL);
+#endif
+	ccl_epoch_release(rec);
+	return;
+}
+
+bool ccl_epoch_enter(void)
+{
+	ccl_epoch_record *rec = ccl_epoch_self;
+
+	if (rec == NULL && (rec = ccl_epoch_acquire()) == NULL)
+		return false;
+	if (rec->nest++ == 0) {
+		__atomic_store_n(&rec->state, (__atomic_load_n(&ccl_epoch_global, __ATOMIC_RELAXED) << 1) | 1, __ATOMIC_RELAXED);
+		// the section is visible before any shared pointer is loaded
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+	return true;
+}
+
+void ccl_epoch_exit(void)
+{
+	ccl_epoch_record *rec = ccl_epoch_self;
+
+	if (--rec->nest == 0)
+		__atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+	return;
+}
+
+static bool ccl_epoch_grow(ccl_epoch_record *rec)
+{
+	struct ccl_epoch_entry *bag;
+	size_t cap;
+
+	if (rec->head >= rec->cap / 2 && rec->head > 0) {
+		memmove(rec->bag, rec->bag + rec->head, (rec->tail - rec->head) * sizeof(*bag));
+		rec->tail -= rec->head;
+		rec->head = 0;
+		return true;
+	}
+	cap = (rec->cap ? rec->cap * 2 : 2 * EPOCH_BATCH);
+	bag = realloc(rec->bag, cap * sizeof(*bag));
+	if (bag == NULL)
+		return false;
+	rec->bag = bag;
+	rec->cap = cap;
+	return true;
+}
+
+static bool ccl_epoch_queue(void *p, ccl_epoch_cb cb, void *ctx, ccl_free_cb free_cb)
+{
+	ccl_epoch_record *rec = ccl_epoch_self;
+	struct ccl_epoch_entry *entry;
+
+	if (rec == NULL && (rec = ccl_epoch_acquire()) == NULL)
+		return false;
+	ccl_epoch_lock(rec);
+	if (rec->tail == rec->cap && !ccl_epoch_grow(rec)) {
+		ccl_epoch_unlock(rec);
+		return false;
+	}
+	entry = &rec->bag[rec->tail++];
+	entry->p = p;
+	entry->cb = cb;
+	if (cb != NULL)
+		entry->arg.ctx = ctx;
+	else
+		entry->arg.free = free_cb;
+	entry->epoch = __atomic_load_n(&ccl_epoch_global, __ATOMIC_SEQ_CST);
+	ccl_epoch_unlock(rec);
+	if (++rec->retired >= EPOCH_BATCH) {
+		rec->retired = 0;
+		if (!__atomic_load_n(&ccl_epoch_background, __ATOMIC_RELAXED))
+			ccl_epoch_collect(rec);
+	}
+	return true;
+}
+
+/*
+ * Free p with free_cb, or run cb(ctx, p), once no reader can reach p any
+ * more; p must already be unlinked.  Returns false if there is no memory
+ * to queue it, the caller then has to ccl_epoch_synchronize() and release
+ * p itself.
+ */
+bool ccl_epoch_retire(void *p, ccl_free_cb free_cb)
+{
+	return ccl_epoch_queue(p, NULL, NULL, free_cb);
+}
+
+bool ccl_epoch_retire_ex(void *p, ccl_epoch_cb cb, void *ctx)
+{
+	return ccl_epoch_queue(p, cb, ctx, NULL);
+}
+
+/* release what the calling thread retired and is safe by now, e.g. when idle */
+void ccl_epoch_reclaim(void)
+{
+	if (ccl_epoch_self != NULL)
+		ccl_epoch_collect(ccl_epoch_self);
+	return;
+}
+
+/*
+ * Wait until every critical section that was running on entry has ended.
+ * Must not be called from inside a critical section.
+ */
+void ccl_epoch_synchronize(void)
+{
+	unsigned long target;
+
+	target = __atomic_load_n(&ccl_epoch_global, __ATOMIC_SEQ_CST) + 2;
+	while ((long)(target - ccl_epoch_advance()) > 0)
+		ccl_epoch_relax();
+	return;
+}
+
+/*
+ * Run the callbacks of everything retired so far, by any thread, e.g.
+ * before tearing down the structure the callbacks refer to; callbacks
+ * another thread already took from a bag are waited for.  Same
+ * restriction as ccl_epoch_synchronize(), and not from a callback.
+ */
+void ccl_epoch_barrier(void)
+{
+	ccl_epoch_record *rec;
+	unsigned long e;
+
+	e = __atomic_load_n(&ccl_epoch_global, __ATOMIC_SEQ_CST);
+	ccl_epoch_synchronize();
+	for (rec = __atomic_load_n(&ccl_epoch_records, __ATOMIC_ACQUIRE); rec != NULL; rec = rec->next) {
+		ccl_epoch_run(rec, e);
+		while (__atomic_load_n(&rec->running, __ATOMIC_ACQUIRE) != 0)
+			ccl_epoch_relax();
+	}
+	return;
+}
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t ccl_epoch_reclaimer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ccl_epoch_reclaimer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t ccl_epoch_reclaimer;
+static unsigned ccl_epoch_interval;
+static bool ccl_epoch_stopping;
+
+static void *ccl_epoch_reclaimer_run(void *arg)
+{
+	ccl_epoch_record *rec;
+	struct timespec ts;
+	unsigned long e;
+
+	(void)arg;
+	pthread_mutex_lock(&ccl_epoch_reclaimer_lock);
+	while (!ccl_epoch_stopping) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += ccl_epoch_interval / 1000;
+		ts.tv_nsec += (long)(ccl_epoch_interval % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&ccl_epoch_reclaimer_cond, &ccl_epoch_reclaimer_lock, &ts);
+		if (ccl_epoch_stopping)
+			break;
+		pthread_mutex_unlock(&ccl_epoch_reclaimer_lock);
+		e = ccl_epoch_advance();
+		if (e >= 2) {
+			for (rec = __atomic_load_n(&ccl_epoch_records, __ATOMIC_ACQUIRE); rec != NULL; rec = rec->next)
+				ccl_epoch_run(rec, e - 2);
+		}
+		pthread_mutex_lock(&ccl_epoch_reclaimer_lock);
+	}
+	pthread_mutex_unlock(&ccl_epoch_reclaimer_lock);
+	return NULL;
+}
+#endif
+
+/*
+ * Move reclamation off the retiring threads: a library thread advances
+ * the epoch and releases everyone's retired memory every interval_ms
+ * (at least 1).  Returns false without pthreads or if it is running.
+ */
+bool ccl_epoch_reclaimer_start(unsigned interval_ms)
+{
+#ifdef HAVE_PTHREAD_H
+	bool started;
+
+	pthread_mutex_lock(&ccl_epoch_reclaimer_lock);
+	started = false;
+	if (!__atomic_load_n(&ccl_epoch_background, __ATOMIC_RELAXED)) {
+		ccl_epoch_interval = (interval_ms ? interval_ms : 1);
+		ccl_epoch_stopping = false;
+		started = (pthread_create(&ccl_epoch_reclaimer, NULL, ccl_epoch_reclaimer_run, NULL) == 0);
+		__atomic_store_n(&ccl_epoch_background, started, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&ccl_epoch_reclaimer_lock);
+	return started;
+#else
+	(void)interval_ms;
+	return false;
+#endif
+}
+
+/* stop the reclaimer, retiring threads reclaim for themselves again */
+void ccl_epoch_reclaimer_stop(void)
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ccl_epoch_reclaimer_lock);
+	if (!__atomic_load_n(&ccl_epoch_background, __ATOMIC_RELAXED)) {
+		pthread_mutex_unlock(&ccl_epoch_reclaimer_lock);
+		return;
+	}
+	ccl_epoch_stopping = true;
+	pthread_cond_signal(&ccl_epoch_reclaimer_cond);
+	pthread_mutex_unlock(&ccl_epoch_reclaimer_lock);
+	pthread_join(ccl_epoch_reclaimer, NULL);
+	__atomic_store_n(&ccl_epoch_background, false, __ATOMIC_RELAXED);
+#endif
+	return;
+}
@@ -20,18 +20,31 @@
 
 #include "hashtable.h"
 
-static const unsigned ccl_primes[] = {
+static const size_t ccl_primes[] = {
 	11,         17,         37,         67,         131,
 	257,        521,        1031,       2053,       4099,
 	8209,       16411,      32771,      65537,      131101,
 	262147,     524309,     1048583,    2097169,    4194319,
 	8388617,    16777259,   33554467,   67108879,   134217757,
 	268435459,  536870923,  1073741827, 2147483659, 4294967291
+#if SIZE_MAX > 0xffffffffU
+	,
+	8589934609,          17179869209,         34359738421,
+	68719476767,         137438953481,        274877906951,
+	549755813911,        1099511627791,       2199023255579,
+	4398046511119,       8796093022237,       17592186044423,
+	35184372088891,      70368744177679,      140737488355333,
+	281474976710677,     562949953421381,     1125899906842679,
+	2251799813685269,    4503599627370517,    9007199254740997,
+	18014398509482143,   36028797018963971,   72057594037928017,
+	144115188075855881,  288230376151711813,  576460752303423619,
+	1152921504606847009, 2305843009213693967, 4611686018427388039
+#endif
 };
 
 static const unsigned ccl_num_primes = sizeof(ccl_primes) / sizeof(ccl_primes[0]);
 
-unsigned ccl_ht_prime_geq(unsigned n)
+size_t ccl_ht_prime_geq(size_t n)
 {
 	unsigned index;
 
@@ -41,3 +54,17 @@ unsigned ccl_ht_prime_geq(unsigned n)
 	}
 	return ccl_primes[ccl_num_primes - 1];
 }
+
+#define CCL_HT_POW2_MIN		((size_t)8)
+#define CCL_HT_POW2_MAX		(~(SIZE_MAX >> 1))
+
+size_t ccl_ht_pow2_geq(size_t n)
+{
+	size_t size;
+
+	if (n >= CCL_HT_POW2_MAX)
+		return CCL_HT_POW2_MAX;
+	for (size = CCL_HT_POW2_MIN; size < n; size <<= 1)
+		;
+	return size;
+}
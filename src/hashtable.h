@@ -21,6 +21,83 @@
 #ifndef CCL_HASHTABLE_H
 #define CCL_HASHTABLE_H
 
-unsigned ccl_ht_prime_geq(unsigned n);
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <classic/common.h>
+
+size_t ccl_ht_prime_geq(size_t n);
+size_t ccl_ht_pow2_geq(size_t n);
+
+/*
+ * Bucket selection.  By default tables have a prime number of buckets and
+ * use the user hash as is, which tolerates weak hash functions.  With
+ * CCL_HT_POW2 the table size is a power of two, the user hash is passed
+ * through the murmur3 finalizer once and the bucket is a mask of the result.
+ */
+static inline unsigned ccl_ht_mix(unsigned h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h;
+}
+
+static inline uint64_t ccl_ht_mix64(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/*
+ * Hashes are 64 bits wide inside the tables.  32-bit callbacks are widened,
+ * tables built with a ccl_hash64_cb (*_new64) get all 64 bits, which keeps
+ * fingerprints and chains selective beyond a few billion entries.
+ */
+static inline uint64_t ccl_ht_rehash(uint64_t hash, bool wide, unsigned flags)
+{
+	if (!(flags & CCL_HT_POW2))
+		return hash;
+	return (wide ? ccl_ht_mix64(hash) : ccl_ht_mix((unsigned)hash));
+}
+
+static inline uint64_t ccl_ht_hash(ccl_hash_cb hash_cb, ccl_hash64_cb hash64_cb, const void *k, unsigned flags)
+{
+	if (hash64_cb != NULL)
+		return ccl_ht_rehash(hash64_cb(k), true, flags);
+	return ccl_ht_rehash(hash_cb(k), false, flags);
+}
+
+static inline size_t ccl_ht_size_geq(size_t n, unsigned flags)
+{
+	return (flags & CCL_HT_POW2 ? ccl_ht_pow2_geq(n) : ccl_ht_prime_geq(n));
+}
+
+static inline size_t ccl_ht_index(uint64_t hash, size_t size, unsigned flags)
+{
+	if (flags & CCL_HT_POW2)
+		return (size_t)(hash & (size - 1));
+	if (((hash | size) >> 32) == 0)		// 32-bit division is much cheaper
+		return (uint32_t)hash % (uint32_t)size;
+	return (size_t)(hash % size);
+}
+
+/*
+ * Batch operations hash CCL_HT_BATCH keys ahead and prefetch their buckets
+ * before resolving them, so the cache misses of a window overlap.
+ */
+#define CCL_HT_BATCH		16
+
+#ifdef __GNUC__
+#define ccl_ht_prefetch(p)	__builtin_prefetch(p)
+#else
+#define ccl_ht_prefetch(p)	((void)(p))
+#endif
 
 #endif
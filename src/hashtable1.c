@@ -25,14 +25,22 @@
 #include <classic/hashtable1.h>
 
 #include "hashtable.h"
+#include "pool.h"
 
-#define HT_ELEM_SIZE		sizeof(ccl_ht1_node)
+#define HT_ELEM_SIZE		sizeof(ccl_ht1_node *)
 
-static ccl_ht1_node *ccl_ht1_node_alloc(void *k, void *v, unsigned hash)
+/*
+ * In CCL_HT_INCREMENTAL mode a resize only allocates the new bucket
+ * array; every select/insert/unlink then moves MIGRATE_BUCKETS chains
+ * from the old array, so no single operation pays for the whole rehash.
+ */
+#define MIGRATE_BUCKETS		4
+
+static ccl_ht1_node *ccl_ht1_node_alloc(ccl_ht1 *ht, void *k, void *v, uint64_t hash)
 {
 	ccl_ht1_node *node;
 
-	node = malloc(sizeof(*node));
+	node = ccl_pool_get(ht->pool, ht->allocator, sizeof(*node));
 	if (node == NULL)
 		return NULL;
 	node->next = NULL;
@@ -42,50 +50,87 @@ static ccl_ht1_node *ccl_ht1_node_alloc(void *k, void *v, unsigned hash)
 	return node;
 }
 
-static void ccl_ht1_node_dealloc(ccl_ht1_node *node, void **k, void **v)
+static void ccl_ht1_node_dealloc(ccl_ht1 *ht, ccl_ht1_node *node, void **k, void **v)
 {
 	*k = node->key;
 	*v = node->value;
-	free(node);
+	ccl_pool_put(ht->pool, ht->allocator, node);
 	return;
 }
 
-ccl_ht1 *ccl_ht1_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned size)
+static ccl_ht1 *ccl_ht1_create(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, ccl_hash64_cb hash64_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_ht1 *ht;
 
-	if (cmp_cb == NULL || hash_cb == NULL)
+	if (cmp_cb == NULL || (hash_cb == NULL && hash64_cb == NULL))
 		return NULL;
-	ht = malloc(sizeof(*ht));
+	ht = ccl_mem_alloc(allocator, sizeof(*ht));
 	if (ht == NULL)
 		return NULL;
-	ht->size = ccl_ht_prime_geq(size);
-	ht->table = calloc(ht->size, HT_ELEM_SIZE);
+	ht->size = ccl_ht_size_geq(size, flags);
+	ht->table = ccl_mem_calloc(allocator, ht->size, HT_ELEM_SIZE);
 	if (ht->table == NULL)
 		goto err;
-	memset(ht->table, 0, ht->size * HT_ELEM_SIZE);
+	ht->allocator = allocator;
+	ht->otable = NULL;
+	ht->osize = 0;
+	ht->migrate = 0;
 	ht->cmp = cmp_cb;
 	ht->kfree = kfree_cb;
 	ht->vfree = vfree_cb;
 	ht->hash = hash_cb;
+	ht->hash64 = hash64_cb;
 	ht->count = 0;
+	ht->flags = flags;
+	ht->pool = NULL;
+	if (flags & CCL_POOL) {
+		ht->pool = ccl_pool_new_ex(sizeof(ccl_ht1_node), allocator);
+		if (ht->pool == NULL)
+			goto err_table;
+	}
 	return ht;
+err_table:
+	ccl_mem_free(allocator, ht->table);
 err:
-	free(ht);
+	ccl_mem_free(allocator, ht);
 	return NULL;
 }
 
-size_t ccl_ht1_clear(ccl_ht1 *ht)
+ccl_ht1 *ccl_ht1_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	if (hash_cb == NULL)
+		return NULL;
+	return ccl_ht1_create(cmp_cb, kfree_cb, vfree_cb, hash_cb, NULL, size, flags, allocator);
+}
+
+/*
+ * Tables hashed by a 32-bit callback stop spreading out at 2^32 buckets;
+ * beyond that (or to keep chains short with billions of keys) use a 64-bit
+ * hash callback.
+ */
+ccl_ht1 *ccl_ht1_new64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	if (hash_cb == NULL)
+		return NULL;
+	return ccl_ht1_create(cmp_cb, kfree_cb, vfree_cb, NULL, hash_cb, size, flags, allocator);
+}
+
+ccl_ht1 *ccl_ht1_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size)
+{
+	return ccl_ht1_new_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, 0, NULL);
+}
+
+static void ccl_ht1_clear_table(ccl_ht1 *ht, ccl_ht1_node **table, size_t from, size_t size)
 {
 	ccl_ht1_node *node, *next;
 	void *k, *v;
-	size_t i, count;
+	size_t i;
 
-	for (i = 0; i < ht->size; i++) {
-		node = ht->table[i];
+	for (i = from; i < size; i++) {
+		node = table[i];
 		while (node != NULL) {
 			next = node->next;
-			ccl_ht1_node_dealloc(node, &k, &v);
+			ccl_ht1_node_dealloc(ht, node, &k, &v);
 			if (ht->kfree)
 				ht->kfree(k);
 			if (ht->vfree)
@@ -93,7 +138,29 @@ size_t ccl_ht1_clear(ccl_ht1 *ht)
 			node = next;
 		}
 	}
+	return;
+}
+
+size_t ccl_ht1_clear(ccl_ht1 *ht)
+{
+	size_t count;
+	bool walk;
+
+	// pooled nodes with nothing to release per node go with their chunks
+	walk = (ht->pool == NULL || ht->kfree != NULL || ht->vfree != NULL);
+	if (walk)
+		ccl_ht1_clear_table(ht, ht->table, 0, ht->size);
 	memset(ht->table, 0, ht->size * HT_ELEM_SIZE);
+	if (ht->otable != NULL) {
+		if (walk)
+			ccl_ht1_clear_table(ht, ht->otable, ht->migrate, ht->osize);
+		ccl_mem_free(ht->allocator, ht->otable);
+		ht->otable = NULL;
+		ht->osize = 0;
+		ht->migrate = 0;
+	}
+	if (ht->pool != NULL)
+		ccl_pool_clear(ht->pool);
 	count = ht->count;
 	ht->count = 0;
 	return count;
@@ -102,27 +169,72 @@ size_t ccl_ht1_clear(ccl_ht1 *ht)
 void ccl_ht1_free(ccl_ht1 *ht)
 {
 	ccl_ht1_clear(ht);
-	free(ht->table);
-	free(ht);
+	if (ht->pool != NULL)
+		ccl_pool_free(ht->pool);
+	ccl_mem_free(ht->allocator, ht->table);
+	ccl_mem_free(ht->allocator, ht);
+	return;
+}
+
+static void ccl_ht1_link(ccl_ht1_node **table, size_t hn, ccl_ht1_node *node)
+{
+	ccl_ht1_node **pnode;
+
+	for (pnode = &table[hn]; *pnode != NULL; pnode = &(*pnode)->next) {
+		if (node->hash < (*pnode)->hash)
+			break;
+	}
+	node->next = *pnode;
+	*pnode = node;
 	return;
 }
 
-static ccl_ht1_node *ccl_ht1_search_node(ccl_ht1 *ht, void *k)
+static void ccl_ht1_migrate(ccl_ht1 *ht, size_t nbuckets)
 {
 	ccl_ht1_node *node, *next;
-	unsigned hn, hash;
 
-	hash = ht->hash(k);
-	hn = hash % ht->size;
+	while (ht->otable != NULL && nbuckets-- > 0) {
+		node = ht->otable[ht->migrate];
+		while (node != NULL) {
+			next = node->next;
+			ccl_ht1_link(ht->table, ccl_ht_index(node->hash, ht->size, ht->flags), node);
+			node = next;
+		}
+		if (++ht->migrate < ht->osize)
+			continue;
+		ccl_mem_free(ht->allocator, ht->otable);
+		ht->otable = NULL;
+		ht->osize = 0;
+		ht->migrate = 0;
+	}
+	return;
+}
+
+/* head of the chain holding hash: old buckets are valid until migrated */
+static ccl_ht1_node **ccl_ht1_bucket(ccl_ht1 *ht, uint64_t hash)
+{
+	size_t hn;
+
+	if (ht->otable != NULL) {
+		hn = ccl_ht_index(hash, ht->osize, ht->flags);
+		if (hn >= ht->migrate)
+			return &ht->otable[hn];
+	}
+	return &ht->table[ccl_ht_index(hash, ht->size, ht->flags)];
+}
+
+static ccl_ht1_node *ccl_ht1_search_node(ccl_ht1 *ht, void *k, uint64_t hash)
+{
+	ccl_ht1_node *node;
 
-	node = ht->table[hn];
+	ccl_ht1_migrate(ht, MIGRATE_BUCKETS);
+	node = *ccl_ht1_bucket(ht, hash);
 	while (node != NULL) {
-		next = node->next;
-		if (hash > node->hash)
+		if (hash < node->hash)
 			return NULL;
-		if (!ht->cmp(k, node->key))
+		if (hash == node->hash && !ht->cmp(k, node->key))
 			break;
-		node = next;
+		node = node->next;
 	}
 	return node;
 }
@@ -133,155 +245,100 @@ bool ccl_ht1_select(ccl_ht1 *ht, void *k, void **v)
 
 	if (k == NULL)
 		return false;
-	node = ccl_ht1_search_node(ht, k);
+	node = ccl_ht1_search_node(ht, k, ccl_ht_hash(ht->hash, ht->hash64, k, ht->flags));
 	if (node == NULL)
 		return false;
 	*v = node->value;
 	return true;
 }
 
-static void ccl_ht1_transform(ccl_ht1 *ht, unsigned nsize)
+static void ccl_ht1_transform(ccl_ht1 *ht, size_t nsize)
 {
-	ccl_ht1_node *node, *node2, *prev2, *next, **table;
-	unsigned hn;
-	size_t i;
+	ccl_ht1_node **table;
 
-	nsize = ccl_ht_prime_geq(nsize);
+	ccl_ht1_migrate(ht, ht->osize);		// finish the previous resize
+	nsize = ccl_ht_size_geq(nsize, ht->flags);
 	if (nsize == ht->size)
 		return;
-	table = calloc(nsize, HT_ELEM_SIZE);
+	table = ccl_mem_calloc(ht->allocator, nsize, HT_ELEM_SIZE);
 	if (table == NULL)	// hash table is unchanged
 		return;
 
-	for (i = 0; i < ht->size; i++) {
-		node = ht->table[i];
-		while (node != NULL) {
-			next = node->next;
-
-			hn = node->hash % nsize;
-
-			if (table[hn] == NULL) {
-				table[hn] = node;
-				node->next = NULL;
-				goto next;
-			}
-
-			node2 = table[hn];
-			prev2 = NULL;
-			while (node2 != NULL) {
-
-				if (node->hash < node2->hash)
-					break;
-				prev2 = node2;
-				node2 = node2->next;
-
-			}
-
-			if (node2 == NULL) {
-				node->next = NULL;
-				prev2->next = node;
-				goto next;
-			}
-
-			if (prev2 == NULL) {
-				node->next = node2;
-				table[hn] = node;
-			} else {
-				node->next = node2;
-				prev2->next = node;
-			}
-next:
-			node = next;
-		}
-	}
-
-	free(ht->table);
+	ht->otable = ht->table;
+	ht->osize = ht->size;
+	ht->migrate = 0;
 	ht->table = table;
 	ht->size = nsize;
+	if (!(ht->flags & CCL_HT_INCREMENTAL))
+		ccl_ht1_migrate(ht, ht->osize);
 	return;
 }
 
 #define LOADFACTOR_NUMERATOR		2
 #define LOADFACTOR_DENOMINATOR		3
 
-bool ccl_ht1_insert(ccl_ht1 *ht, void *k, void *v, void **pv)
+static bool _ccl_ht1_insert(ccl_ht1 *ht, void *k, void *v, uint64_t hash, void **pv)
 {
-	ccl_ht1_node *node, *prev;
-	unsigned hn, hash;
+	ccl_ht1_node *node, **pnode;
 
-	*pv = NULL;
-	if (k == NULL)
-		return false;
 	if (LOADFACTOR_DENOMINATOR * ht->count >= LOADFACTOR_NUMERATOR * ht->size)
 		ccl_ht1_transform(ht, ht->size + 1);
-	
-	hash = ht->hash(k);
-	hn = hash % ht->size;
+	ccl_ht1_migrate(ht, MIGRATE_BUCKETS);
 
-	node = ht->table[hn];
-	prev = NULL;
-	while (node != NULL) {
+	for (pnode = ccl_ht1_bucket(ht, hash); *pnode != NULL; pnode = &(*pnode)->next) {
+		node = *pnode;
 		if (hash < node->hash)
 			break;
-		if (!ht->cmp(k, node->key)) {
+		if (hash == node->hash && !ht->cmp(k, node->key)) {
 			*pv = &node->value;
 			return false;
 		}
-		prev = node;
-		node = node->next;
 	}
 
-	node = ccl_ht1_node_alloc(k, v, hash);
+	node = ccl_ht1_node_alloc(ht, k, v, hash);
 	if (node == NULL)
 		return false;
-	if (ht->table[hn] == NULL) {
-		ht->table[hn] = node;
-		goto out;
-	}
-
-	if (prev == NULL) {
-		node->next = ht->table[hn];
-		ht->table[hn] = node;
-	} else {
-		node->next = prev->next;
-		prev->next = node;
-	}
-out:
+	node->next = *pnode;
+	*pnode = node;
 	*pv = &node->value;
 	ht->count++;
 	return true;
 }
 
-bool ccl_ht1_unlink(ccl_ht1 *ht, void *key, void **k, void **v)
+bool ccl_ht1_insert(ccl_ht1 *ht, void *k, void *v, void **pv)
 {
-	ccl_ht1_node *node, *prev;
-	unsigned hn, hash;
-
-	if (key == NULL)
+	*pv = NULL;
+	if (k == NULL)
 		return false;
-	hash = ht->hash(key);
-	hn = hash % ht->size;
+	return _ccl_ht1_insert(ht, k, v, ccl_ht_hash(ht->hash, ht->hash64, k, ht->flags), pv);
+}
 
-	node = ht->table[hn];
-	prev = NULL;
-	while (node != NULL) {
+static bool _ccl_ht1_unlink(ccl_ht1 *ht, void *key, uint64_t hash, void **k, void **v)
+{
+	ccl_ht1_node *node, **pnode;
+
+	ccl_ht1_migrate(ht, MIGRATE_BUCKETS);
+	for (pnode = ccl_ht1_bucket(ht, hash); *pnode != NULL; pnode = &node->next) {
+		node = *pnode;
 		if (hash < node->hash)
 			return false;
-		if (!ht->cmp(key, node->key)) {
-			if (prev == NULL)
-				ht->table[hn] = node->next;
-			else
-				prev->next = node->next;
-			ccl_ht1_node_dealloc(node, k, v);
+		if (hash == node->hash && !ht->cmp(key, node->key)) {
+			*pnode = node->next;
+			ccl_ht1_node_dealloc(ht, node, k, v);
 			ht->count--;
 			return true;
 		}
-		prev = node;
-		node = node->next;
 	}
 	return false;
 }
 
+bool ccl_ht1_unlink(ccl_ht1 *ht, void *key, void **k, void **v)
+{
+	if (key == NULL)
+		return false;
+	return _ccl_ht1_unlink(ht, key, ccl_ht_hash(ht->hash, ht->hash64, key, ht->flags), k, v);
+}
+
 bool ccl_ht1_delete(ccl_ht1 *ht, void *key)
 {
 	void *k, *v;
@@ -295,13 +352,142 @@ bool ccl_ht1_delete(ccl_ht1 *ht, void *key)
         return true;
 }
 
-bool ccl_ht1_foreach(ccl_ht1 *ht, ccl_dforeach_cb cb, void *user)
+/*
+ * Variants for callers that already know the key's hash: hash must be what
+ * the table's hash callback returns for k, which is then not called.
+ */
+bool ccl_ht1_select_hashed(ccl_ht1 *ht, void *k, uint64_t hash, void **v)
+{
+	ccl_ht1_node *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_ht1_search_node(ht, k, ccl_ht_rehash(hash, ht->hash64 != NULL, ht->flags));
+	if (node == NULL)
+		return false;
+	*v = node->value;
+	return true;
+}
+
+bool ccl_ht1_insert_hashed(ccl_ht1 *ht, void *k, void *v, uint64_t hash, void **pv)
+{
+	*pv = NULL;
+	if (k == NULL)
+		return false;
+	return _ccl_ht1_insert(ht, k, v, ccl_ht_rehash(hash, ht->hash64 != NULL, ht->flags), pv);
+}
+
+bool ccl_ht1_delete_hashed(ccl_ht1 *ht, void *key, uint64_t hash)
+{
+	void *k, *v;
+
+	if (key == NULL || !_ccl_ht1_unlink(ht, key, ccl_ht_rehash(hash, ht->hash64 != NULL, ht->flags), &k, &v))
+		return false;
+	if (ht->kfree != NULL)
+		ht->kfree(k);
+	if (ht->vfree != NULL)
+		ht->vfree(v);
+	return true;
+}
+
+/*
+ * Hash a window of keys and prefetch their chain heads, then the first
+ * node of each chain, and only then walk the chains.  NULL keys are
+ * skipped.
+ */
+static unsigned ccl_ht1_prefetch(ccl_ht1 *ht, void **keys, size_t n, uint64_t *hashes)
+{
+	ccl_ht1_node **heads[CCL_HT_BATCH];
+	unsigned i, w;
+
+	w = (n < CCL_HT_BATCH ? (unsigned)n : CCL_HT_BATCH);
+	for (i = 0; i < w; i++) {
+		hashes[i] = (keys[i] ? ccl_ht_hash(ht->hash, ht->hash64, keys[i], ht->flags) : 0);
+		heads[i] = ccl_ht1_bucket(ht, hashes[i]);
+		ccl_ht_prefetch(heads[i]);
+	}
+	for (i = 0; i < w; i++)
+		ccl_ht_prefetch(*heads[i]);
+	return w;
+}
+
+// values may be NULL; returns the number of keys that were not yet present
+size_t ccl_ht1_insert_batch(ccl_ht1 *ht, void **keys, void **values, size_t n)
+{
+	uint64_t hashes[CCL_HT_BATCH];
+	unsigned i, w;
+	size_t done, count, need;
+	void *pv;
+
+	// one resize up front instead of several along the way
+	if (LOADFACTOR_DENOMINATOR * (ht->count + n) >= LOADFACTOR_NUMERATOR * ht->size) {
+		need = (ht->count + n) * LOADFACTOR_DENOMINATOR / LOADFACTOR_NUMERATOR + 1;
+		ccl_ht1_transform(ht, need);
+	}
+	count = 0;
+	for (done = 0; done < n; done += w) {
+		w = ccl_ht1_prefetch(ht, keys + done, n - done, hashes);
+		for (i = 0; i < w; i++) {
+			if (keys[done + i] != NULL && _ccl_ht1_insert(ht, keys[done + i],
+			    (values ? values[done + i] : NULL), hashes[i], &pv))
+				count++;
+		}
+	}
+	return count;
+}
+
+// values[i] is set to NULL for missing keys; returns the number found
+size_t ccl_ht1_select_batch(ccl_ht1 *ht, void **keys, size_t n, void **values)
+{
+	ccl_ht1_node *node;
+	uint64_t hashes[CCL_HT_BATCH];
+	unsigned i, w;
+	size_t done, count;
+
+	count = 0;
+	for (done = 0; done < n; done += w) {
+		w = ccl_ht1_prefetch(ht, keys + done, n - done, hashes);
+		for (i = 0; i < w; i++) {
+			node = (keys[done + i] ? ccl_ht1_search_node(ht, keys[done + i], hashes[i]) : NULL);
+			values[done + i] = (node ? node->value : NULL);
+			if (node)
+				count++;
+		}
+	}
+	return count;
+}
+
+// returns the number of keys deleted
+size_t ccl_ht1_delete_batch(ccl_ht1 *ht, void **keys, size_t n)
+{
+	uint64_t hashes[CCL_HT_BATCH];
+	unsigned i, w;
+	size_t done, count;
+	void *k, *v;
+
+	count = 0;
+	for (done = 0; done < n; done += w) {
+		w = ccl_ht1_prefetch(ht, keys + done, n - done, hashes);
+		for (i = 0; i < w; i++) {
+			if (keys[done + i] == NULL || !_ccl_ht1_unlink(ht, keys[done + i], hashes[i], &k, &v))
+				continue;
+			if (ht->kfree != NULL)
+				ht->kfree(k);
+			if (ht->vfree != NULL)
+				ht->vfree(v);
+			count++;
+		}
+	}
+	return count;
+}
+
+static bool ccl_ht1_foreach_table(ccl_ht1_node **table, size_t from, size_t size, ccl_dforeach_cb cb, void *user)
 {
 	ccl_ht1_node *node;
 	size_t i;
 
-	for (i = 0; i < ht->size; i++) {
-		node = ht->table[i];
+	for (i = from; i < size; i++) {
+		node = table[i];
 		while (node != NULL) {
 			if (!cb(node->key, node->value, user))
 				return false;
@@ -311,29 +497,60 @@ bool ccl_ht1_foreach(ccl_ht1 *ht, ccl_dforeach_cb cb, void *user)
 	return true;
 }
 
+bool ccl_ht1_foreach(ccl_ht1 *ht, ccl_dforeach_cb cb, void *user)
+{
+	if (!ccl_ht1_foreach_table(ht->table, 0, ht->size, cb, user))
+		return false;
+	if (ht->otable == NULL)
+		return true;
+	return ccl_ht1_foreach_table(ht->otable, ht->migrate, ht->osize, cb, user);
+}
+
 static struct ccl_map_ops map_ops = {
-	(ccl_map_free_cb)ccl_ht1_free,
-	(ccl_map_clear_cb)ccl_ht1_clear,
-	(ccl_map_select_cb)ccl_ht1_select,
-	(ccl_map_insert_cb)ccl_ht1_insert,
-	(ccl_map_delete_cb)ccl_ht1_delete,
-	(ccl_map_foreach_cb)ccl_ht1_foreach,
+	.free		= (ccl_map_free_cb)ccl_ht1_free,
+	.clear		= (ccl_map_clear_cb)ccl_ht1_clear,
+	.select		= (ccl_map_select_cb)ccl_ht1_select,
+	.insert		= (ccl_map_insert_cb)ccl_ht1_insert,
+	.delete		= (ccl_map_delete_cb)ccl_ht1_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_ht1_foreach,
+	.insert_batch	= (ccl_map_insert_batch_cb)ccl_ht1_insert_batch,
+	.select_batch	= (ccl_map_select_batch_cb)ccl_ht1_select_batch,
+	.delete_batch	= (ccl_map_delete_batch_cb)ccl_ht1_delete_batch,
+	.select_hashed	= (ccl_map_select_hashed_cb)ccl_ht1_select_hashed,
+	.insert_hashed	= (ccl_map_insert_hashed_cb)ccl_ht1_insert_hashed,
+	.delete_hashed	= (ccl_map_delete_hashed_cb)ccl_ht1_delete_hashed,
 };
 
-ccl_map *ccl_umap_ht1(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned size)
+static ccl_map *ccl_umap_ht1_wrap(ccl_ht1 *ht, const ccl_allocator *allocator)
 {
 	ccl_map *map;
 
-	map = malloc(sizeof(*map));
-	if (map == NULL)
+	if (ht == NULL)
 		return NULL;
-	map->obj = ccl_ht1_new(cmp_cb, kfree_cb, vfree_cb, hash_cb, size);
-	if (map->obj == NULL)
+	map = ccl_mem_alloc(allocator, sizeof(*map));
+	if (map == NULL)
 		goto err;
+	map->obj = ht;
 	map->ops = &map_ops;
+	map->allocator = allocator;
 	map->sorted = false;
 	return map;
 err:
-	free(map);
+	ccl_ht1_free(ht);
 	return NULL;
 }
+
+ccl_map *ccl_umap_ht1_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	return ccl_umap_ht1_wrap(ccl_ht1_new_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, flags, allocator), allocator);
+}
+
+ccl_map *ccl_umap_ht1_64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	return ccl_umap_ht1_wrap(ccl_ht1_new64(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, flags, allocator), allocator);
+}
+
+ccl_map *ccl_umap_ht1(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size)
+{
+	return ccl_umap_ht1_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, 0, NULL);
+}
@@ -3,8 +3,9 @@
 
    This file is part of libclassic.
    Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
-   Algo: open-addressing hash-table interface.
-   Ref: [Gonnet 1984], [Knuth 1998].
+   Algo: open-addressing hash-table, Robin Hood linear probing with
+         backward-shift deletion and a 1-byte fingerprint per slot.
+   Ref: [Gonnet 1984], [Knuth 1998], [Celis 1986].
 
    The GNU C Library is free software; you can redistribute it and/or
    modify it under the terms of the GNU Lesser General Public
@@ -22,87 +23,222 @@
 
 #include <string.h>
 #include <assert.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include <classic/hashtable2.h>
 
 #include "hashtable.h"
+#include "allocator.h"
+
+/*
+ * Besides the slot array the table keeps ctrl[], one byte per slot: the
+ * top 7 bits of a mixed hash for a used slot or CTRL_EMPTY for a free one.
+ * Probing scans GROUP_SIZE ctrl bytes at once and only touches slots whose
+ * fingerprint matches, so a lookup usually costs one ctrl and one slot
+ * cache line.  The first GROUP_SIZE ctrl bytes are mirrored past the end
+ * so that a group never has to wrap.
+ *
+ * Slots are kept in Robin Hood order, which bounds probe length variance
+ * and lets an unsuccessful lookup stop early; delete shifts the following
+ * entries back by one, so no tombstones are ever left in the table.
+ */
 
 #define HT_ELEM_SIZE			sizeof(ccl_ht2_node)
 #define ccl_ht2_ptr(ht,n)		&(ht)->table[n]
 
-ccl_ht2 *ccl_ht2_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned int size)
+#define GROUP_SIZE			16
+#define CTRL_EMPTY			0x80
+#define CTRL_H2(hash)			((unsigned char)(((hash) * 0x9e3779b97f4a7c15ULL) >> 57))
+
+#define LOADFACTOR_NUMERATOR		7
+#define LOADFACTOR_DENOMINATOR		8
+
+#if defined(__SSE2__)
+static inline unsigned ccl_ht2_match(const unsigned char *ctrl, unsigned char h2)
+{
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+	return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+static inline unsigned ccl_ht2_match_empty(const unsigned char *ctrl)
+{
+	return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else
+static inline unsigned ccl_ht2_match(const unsigned char *ctrl, unsigned char h2)
+{
+	unsigned i, mask = 0;
+
+	for (i = 0; i < GROUP_SIZE; i++)
+		mask |= (unsigned)(ctrl[i] == h2) << i;
+	return mask;
+}
+
+static inline unsigned ccl_ht2_match_empty(const unsigned char *ctrl)
+{
+	unsigned i, mask = 0;
+
+	for (i = 0; i < GROUP_SIZE; i++)
+		mask |= (unsigned)(ctrl[i] >> 7) << i;
+	return mask;
+}
+#endif
+
+static inline void ccl_ht2_set_ctrl(ccl_ht2 *ht, size_t i, unsigned char c)
+{
+	ht->ctrl[i] = c;
+	if (i < GROUP_SIZE)
+		ht->ctrl[ht->size + i] = c;
+	return;
+}
+
+static inline size_t ccl_ht2_next(ccl_ht2 *ht, size_t i, unsigned n)
+{
+	i += n;
+	return (i >= ht->size ? i - ht->size : i);
+}
+
+/* distance of slot i from the home slot of the entry it holds */
+static inline size_t ccl_ht2_disp(ccl_ht2 *ht, size_t i)
+{
+	size_t hn = ccl_ht_index(ht->table[i].hash, ht->size, ht->flags);
+
+	return (i >= hn ? i - hn : i + ht->size - hn);
+}
+
+static bool ccl_ht2_alloc_table(ccl_ht2 *ht, size_t size)
+{
+	ccl_ht2_node *table;
+	unsigned char *ctrl;
+
+	table = ccl_mem_alloc(ht->allocator, size * HT_ELEM_SIZE);
+	if (table == NULL)
+		return false;
+	ctrl = ccl_mem_alloc(ht->allocator, size + GROUP_SIZE);
+	if (ctrl == NULL) {
+		ccl_mem_free(ht->allocator, table);
+		return false;
+	}
+	memset(ctrl, CTRL_EMPTY, size + GROUP_SIZE);
+	ht->table = table;
+	ht->ctrl = ctrl;
+	ht->size = size;
+	return true;
+}
+
+static ccl_ht2 *ccl_ht2_create(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, ccl_hash64_cb hash64_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_ht2 *ht;
 
-	if (cmp_cb == NULL || hash_cb == NULL)
+	if (cmp_cb == NULL || (hash_cb == NULL && hash64_cb == NULL))
 		return NULL;
-	ht = malloc(sizeof(*ht));
+	ht = ccl_mem_alloc(allocator, sizeof(*ht));
 	if (ht == NULL)
 		return NULL;
-	ht->size = ccl_ht_prime_geq(size);
-	ht->table = calloc(ht->size, HT_ELEM_SIZE);
-	if (ht->table == NULL)
+	ht->allocator = allocator;
+	if (size <= GROUP_SIZE)		// a group must not wrap twice
+		size = GROUP_SIZE + 1;
+	if (!ccl_ht2_alloc_table(ht, ccl_ht_size_geq(size, flags)))
 		goto err;
-	memset(ht->table, 0, ht->size * HT_ELEM_SIZE);
 	ht->cmp = cmp_cb;
 	ht->kfree = kfree_cb;
 	ht->vfree = vfree_cb;
 	ht->hash = hash_cb;
+	ht->hash64 = hash64_cb;
 	ht->count = 0;
+	ht->flags = flags;
 	return ht;
 err:
-	free(ht);
+	ccl_mem_free(allocator, ht);
 	return NULL;
 }
 
+ccl_ht2 *ccl_ht2_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	if (hash_cb == NULL)
+		return NULL;
+	return ccl_ht2_create(cmp_cb, kfree_cb, vfree_cb, hash_cb, NULL, size, flags, allocator);
+}
+
+/*
+ * A 32-bit hash callback cannot address more than 2^32 slots and leaves
+ * long probe sequences in tables of that order; very large tables should
+ * be built here, with a 64-bit hash callback.
+ */
+ccl_ht2 *ccl_ht2_new64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	if (hash_cb == NULL)
+		return NULL;
+	return ccl_ht2_create(cmp_cb, kfree_cb, vfree_cb, NULL, hash_cb, size, flags, allocator);
+}
+
+ccl_ht2 *ccl_ht2_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size)
+{
+	return ccl_ht2_new_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, 0, NULL);
+}
+
 size_t ccl_ht2_clear(ccl_ht2 *ht)
 {
 	ccl_ht2_node *node;
 	size_t i, count;
 
 	count = ht->count;
-	for (i = 0; i < ht->size; i++) {
-		node = ccl_ht2_ptr(ht, i);
-		if (node->key == NULL)
+	for (i = 0; i < ht->size && ht->count > 0; i++) {
+		if (ht->ctrl[i] == CTRL_EMPTY)
 			continue;
+		node = ccl_ht2_ptr(ht, i);
 		if (ht->kfree)
 			ht->kfree(node->key);
 		if (ht->vfree)
 			ht->vfree(node->value);
 		ht->count--;
 	}
+	memset(ht->ctrl, CTRL_EMPTY, ht->size + GROUP_SIZE);
+	ht->count = 0;
 	return count;
 }
 
 void ccl_ht2_free(ccl_ht2 *ht)
 {
 	ccl_ht2_clear(ht);
-	free(ht->table);
-	free(ht);
+	ccl_mem_free(ht->allocator, ht->ctrl);
+	ccl_mem_free(ht->allocator, ht->table);
+	ccl_mem_free(ht->allocator, ht);
 	return;
 }
 
-static ccl_ht2_node *ccl_ht2_search_node(ccl_ht2 *ht, void *k)
+static ccl_ht2_node *ccl_ht2_search_node(ccl_ht2 *ht, void *k, uint64_t hash)
 {
 	ccl_ht2_node *node;
-	unsigned hn, i, hash;
-
-	if (k == NULL)
-		return NULL;
-	hash = ht->hash(k);
-	hn = hash % ht->size;
-
-	i = hn;
-	do {
-		node = ccl_ht2_ptr(ht, i);
-		if (node->key == NULL)
+	size_t pos, dist, i;
+	unsigned match, empty;
+	unsigned char h2;
+
+	h2 = CTRL_H2(hash);
+	pos = ccl_ht_index(hash, ht->size, ht->flags);
+	for (dist = 0; dist < ht->size; dist += GROUP_SIZE) {
+		match = ccl_ht2_match(&ht->ctrl[pos], h2);
+		empty = ccl_ht2_match_empty(&ht->ctrl[pos]);
+		if (empty)
+			match &= (empty & -empty) - 1;	// slots before the first hole
+		while (match) {
+			i = ccl_ht2_next(ht, pos, __builtin_ctz(match));
+			node = ccl_ht2_ptr(ht, i);
+			if (node->hash == hash && !ht->cmp(k, node->key))
+				return node;
+			match &= match - 1;
+		}
+		if (empty)
+			break;
+		// Robin Hood order: k would have displaced a less displaced entry
+		i = ccl_ht2_next(ht, pos, GROUP_SIZE - 1);
+		if (ccl_ht2_disp(ht, i) < dist + GROUP_SIZE - 1)
 			break;
-		if (node->hash == hash && !ht->cmp(k, node->key))
-			return node;
-		i++;
-		if (i == ht->size)
-			i = 0;
-	} while (i != hn);
+		pos = ccl_ht2_next(ht, pos, GROUP_SIZE);
+	}
 	return NULL;
 }
 
@@ -110,173 +246,131 @@ bool ccl_ht2_select(ccl_ht2 *ht, void *k, void **v)
 {
 	ccl_ht2_node *node;
 
-	node = ccl_ht2_search_node(ht, k);
+	if (k == NULL)
+		return false;
+	node = ccl_ht2_search_node(ht, k, ccl_ht_hash(ht->hash, ht->hash64, k, ht->flags));
 	if (node == NULL)
 		return false;
 	*v = node->value;
 	return true;
 }
 
-static void ccl_ht2_transform(ccl_ht2 *ht, unsigned nsize)
+/* place an entry known to be absent, returns the slot it ends up in */
+static ccl_ht2_node *ccl_ht2_place(ccl_ht2 *ht, void *k, void *v, uint64_t hash)
 {
-	ccl_ht2_node *table;
-	ccl_ht2_node *node, *node2;
-	size_t i, j;
-	unsigned hn;
+	ccl_ht2_node *node, *placed, n, tmp;
+	size_t i, dist, d;
+	unsigned char h2, c;
+
+	n.key = k;
+	n.value = v;
+	n.hash = hash;
+	h2 = CTRL_H2(hash);
+	placed = NULL;
+	i = ccl_ht_index(hash, ht->size, ht->flags);
+	for (dist = 0; ; dist++, i = ccl_ht2_next(ht, i, 1)) {
+		node = ccl_ht2_ptr(ht, i);
+		if (ht->ctrl[i] == CTRL_EMPTY) {
+			*node = n;
+			ccl_ht2_set_ctrl(ht, i, h2);
+			return (placed ? placed : node);
+		}
+		d = ccl_ht2_disp(ht, i);
+		if (d >= dist)
+			continue;
+		// take the slot of a less displaced entry and carry it on
+		tmp = *node;
+		*node = n;
+		n = tmp;
+		c = ht->ctrl[i];
+		ccl_ht2_set_ctrl(ht, i, h2);
+		h2 = c;
+		dist = d;
+		if (placed == NULL)
+			placed = node;
+	}
+}
+
+static void ccl_ht2_transform(ccl_ht2 *ht, size_t nsize)
+{
+	ccl_ht2 old;
+	size_t i;
 
-	nsize = ccl_ht_prime_geq(nsize);
+	nsize = ccl_ht_size_geq(nsize, ht->flags);
 	if (nsize == ht->size)
 		return;
-	table = calloc(nsize, sizeof(*table));
-	if (table == NULL)      // hash table is unchanged
+	old = *ht;
+	if (!ccl_ht2_alloc_table(ht, nsize))	// hash table is unchanged
 		return;
-	memset(table, 0, nsize * HT_ELEM_SIZE);
-	
-	for (i = 0; i < ht->size; ++i) {
-		node = ccl_ht2_ptr(ht, i);
-		if (node->key == NULL)
-			continue;
-		hn = node->hash % nsize;
-
-		j = hn;
-		do {
-			node2 = &table[j];
-			if (node2->key == NULL) {
-				node2->key = node->key;
-				node2->value = node->value;
-				node2->hash = node->hash;
-				break;
-			}
-
-			if (node->hash == node2->hash && !ht->cmp(node->key, node2->key)) {		// hash table is unchanged
-				free(table);
-				return;
-
-			}
-			j++;
-			if (j == nsize)
-				j = 0;
-		} while(j != hn);
+
+	for (i = 0; i < old.size; i++) {
+		if (old.ctrl[i] != CTRL_EMPTY)
+			ccl_ht2_place(ht, old.table[i].key, old.table[i].value, old.table[i].hash);
 	}
-	free(ht->table);
-	ht->table = table;
-	ht->size = nsize;
+	ccl_mem_free(ht->allocator, old.ctrl);
+	ccl_mem_free(ht->allocator, old.table);
 	return;
 }
 
-#define LOADFACTOR_NUMERATOR    2
-#define LOADFACTOR_DENOMINATOR  3
-
-bool ccl_ht2_insert(ccl_ht2 *ht, void *k, void *v, void **pv)
+static bool _ccl_ht2_insert(ccl_ht2 *ht, void *k, void *v, uint64_t hash, void **pv)
 {
 	ccl_ht2_node *node;
-	unsigned hn, i, hash;
 
-	*pv = NULL;
-	if (k == NULL)
-		return false;
 	if (LOADFACTOR_DENOMINATOR * ht->count >= LOADFACTOR_NUMERATOR * ht->size)
 		ccl_ht2_transform(ht, ht->size + 1);
+	if (ht->count + 1 >= ht->size)		// resize failed and the table is full
+		return false;
 
-	hash = ht->hash(k);
-	hn = hash % ht->size;
-
-	i = hn;
-	do {
-		node = ccl_ht2_ptr(ht, i);
-		if (node->key == NULL) {
-			node->key = k;
-			node->value = v;
-			node->hash = hash;
-			ht->count++;
-			*pv = &node->value;
-			return true;
-		}
-
-		if (node->hash == hash && !ht->cmp(k, node->key)) {
-			*pv = &node->value;
-			return false;
-		}
-		i++;
-		if (i == ht->size)
-			i = 0;
-	} while (i != hn);
+	node = ccl_ht2_search_node(ht, k, hash);
+	if (node != NULL) {
+		*pv = &node->value;
+		return false;
+	}
 
-	return false;
+	node = ccl_ht2_place(ht, k, v, hash);
+	ht->count++;
+	*pv = &node->value;
+	return true;
 }
 
-static void ccl_ht2_update_table(ccl_ht2 *ht, unsigned start, unsigned end)
+bool ccl_ht2_insert(ccl_ht2 *ht, void *k, void *v, void **pv)
 {
-	ccl_ht2_node *node, *node2, n;
-	unsigned hn2, i, j;
+	*pv = NULL;
+	if (k == NULL)
+		return false;
+	return _ccl_ht2_insert(ht, k, v, ccl_ht_hash(ht->hash, ht->hash64, k, ht->flags), pv);
+}
 
-	i = start;
-	do {
-		node = ccl_ht2_ptr(ht, i);
+static bool _ccl_ht2_unlink(ccl_ht2 *ht, void *key, uint64_t hash, void **k, void **v)
+{
+	ccl_ht2_node *node;
+	size_t i, j;
 
-		if (node->key == NULL)
-			return;
-		n = *node;
-		node->key = NULL;
-
-		hn2 = n.hash % ht->size;
-		j = hn2;
-		do {
-			node2 = ccl_ht2_ptr(ht, j);
-			if (node2->key == NULL) {
-				node2->key = n.key;
-				node2->value = n.value;
-				node2->hash = n.hash;
-				break;
-			}
-
-			assert(node2->hash != n.hash || ht->cmp(n.key, node2->key));
-			j++;
-			if (j == ht->size)
-				j = 0;
-		} while (j != hn2);
-
-		i++;
-		if (i == ht->size)
-			i = 0;
-	} while (i != end);
+	node = ccl_ht2_search_node(ht, key, hash);
+	if (node == NULL)
+		return false;
+	*k = node->key;
+	*v = node->value;
+	ht->count--;
 
-	return;
+	// backward shift: pull displaced successors one slot closer to home
+	i = (size_t)(node - ht->table);
+	for (j = ccl_ht2_next(ht, i, 1); ht->ctrl[j] != CTRL_EMPTY; j = ccl_ht2_next(ht, j, 1)) {
+		if (ccl_ht2_disp(ht, j) == 0)
+			break;
+		ht->table[i] = ht->table[j];
+		ccl_ht2_set_ctrl(ht, i, ht->ctrl[j]);
+		i = j;
+	}
+	ccl_ht2_set_ctrl(ht, i, CTRL_EMPTY);
+	return true;
 }
 
 bool ccl_ht2_unlink(ccl_ht2 *ht, void *key, void **k, void **v)
 {
-	ccl_ht2_node *node;
-	unsigned hn, i, hash;
-
 	if (key == NULL)
 		return false;
-	hash = ht->hash(key);
-	hn = hash % ht->size;
-
-	i = hn;
-
-	do {
-		node = ccl_ht2_ptr(ht, i);
-		if (node->key == NULL)
-			return false;
-		if (node->hash == hash && !ht->cmp(key, node->key)) {
-			*k = node->key;
-			*v = node->value;
-			node->key = NULL;
-			ht->count--;
-			i++;
-			if (i == ht->size)
-				i = 0;
-			ccl_ht2_update_table(ht, i, hn);
-			return true;
-		}
-		i++;
-		if (i == ht->size)
-			i = 0;
-	} while (i != hn);
-
-	return false;
+	return _ccl_ht2_unlink(ht, key, ccl_ht_hash(ht->hash, ht->hash64, key, ht->flags), k, v);
 }
 
 bool ccl_ht2_delete(ccl_ht2 *ht, void *key)
@@ -292,15 +386,139 @@ bool ccl_ht2_delete(ccl_ht2 *ht, void *key)
         return true;
 }
 
+/*
+ * Variants for callers that already know the key's hash: hash must be what
+ * the table's hash callback returns for k, which is then not called.
+ */
+bool ccl_ht2_select_hashed(ccl_ht2 *ht, void *k, uint64_t hash, void **v)
+{
+	ccl_ht2_node *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_ht2_search_node(ht, k, ccl_ht_rehash(hash, ht->hash64 != NULL, ht->flags));
+	if (node == NULL)
+		return false;
+	*v = node->value;
+	return true;
+}
+
+bool ccl_ht2_insert_hashed(ccl_ht2 *ht, void *k, void *v, uint64_t hash, void **pv)
+{
+	*pv = NULL;
+	if (k == NULL)
+		return false;
+	return _ccl_ht2_insert(ht, k, v, ccl_ht_rehash(hash, ht->hash64 != NULL, ht->flags), pv);
+}
+
+bool ccl_ht2_delete_hashed(ccl_ht2 *ht, void *key, uint64_t hash)
+{
+	void *k, *v;
+
+	if (key == NULL || !_ccl_ht2_unlink(ht, key, ccl_ht_rehash(hash, ht->hash64 != NULL, ht->flags), &k, &v))
+		return false;
+	if (ht->kfree != NULL)
+		ht->kfree(k);
+	if (ht->vfree != NULL)
+		ht->vfree(v);
+	return true;
+}
+
+// hash a window of keys and prefetch their home groups, NULL keys are skipped
+static unsigned ccl_ht2_prefetch(ccl_ht2 *ht, void **keys, size_t n, uint64_t *hashes)
+{
+	size_t pos;
+	unsigned i, w;
+
+	w = (n < CCL_HT_BATCH ? (unsigned)n : CCL_HT_BATCH);
+	for (i = 0; i < w; i++) {
+		hashes[i] = (keys[i] ? ccl_ht_hash(ht->hash, ht->hash64, keys[i], ht->flags) : 0);
+		pos = ccl_ht_index(hashes[i], ht->size, ht->flags);
+		ccl_ht_prefetch(&ht->ctrl[pos]);
+		ccl_ht_prefetch(&ht->table[pos]);
+	}
+	return w;
+}
+
+// values may be NULL; returns the number of keys that were not yet present
+size_t ccl_ht2_insert_batch(ccl_ht2 *ht, void **keys, void **values, size_t n)
+{
+	uint64_t hashes[CCL_HT_BATCH];
+	unsigned i, w;
+	size_t done, count, need;
+	void *pv;
+
+	// one resize up front instead of several along the way
+	if (LOADFACTOR_DENOMINATOR * (ht->count + n) >= LOADFACTOR_NUMERATOR * ht->size) {
+		need = (ht->count + n) * LOADFACTOR_DENOMINATOR / LOADFACTOR_NUMERATOR + 1;
+		ccl_ht2_transform(ht, need);
+	}
+	count = 0;
+	for (done = 0; done < n; done += w) {
+		w = ccl_ht2_prefetch(ht, keys + done, n - done, hashes);
+		for (i = 0; i < w; i++) {
+			if (keys[done + i] != NULL && _ccl_ht2_insert(ht, keys[done + i],
+			    (values ? values[done + i] : NULL), hashes[i], &pv))
+				count++;
+		}
+	}
+	return count;
+}
+
+// values[i] is set to NULL for missing keys; returns the number found
+size_t ccl_ht2_select_batch(ccl_ht2 *ht, void **keys, size_t n, void **values)
+{
+	ccl_ht2_node *node;
+	uint64_t hashes[CCL_HT_BATCH];
+	unsigned i, w;
+	size_t done, count;
+
+	count = 0;
+	for (done = 0; done < n; done += w) {
+		w = ccl_ht2_prefetch(ht, keys + done, n - done, hashes);
+		for (i = 0; i < w; i++) {
+			node = (keys[done + i] ? ccl_ht2_search_node(ht, keys[done + i], hashes[i]) : NULL);
+			values[done + i] = (node ? node->value : NULL);
+			if (node)
+				count++;
+		}
+	}
+	return count;
+}
+
+// returns the number of keys deleted
+size_t ccl_ht2_delete_batch(ccl_ht2 *ht, void **keys, size_t n)
+{
+	uint64_t hashes[CCL_HT_BATCH];
+	unsigned i, w;
+	size_t done, count;
+	void *k, *v;
+
+	count = 0;
+	for (done = 0; done < n; done += w) {
+		w = ccl_ht2_prefetch(ht, keys + done, n - done, hashes);
+		for (i = 0; i < w; i++) {
+			if (keys[done + i] == NULL || !_ccl_ht2_unlink(ht, keys[done + i], hashes[i], &k, &v))
+				continue;
+			if (ht->kfree != NULL)
+				ht->kfree(k);
+			if (ht->vfree != NULL)
+				ht->vfree(v);
+			count++;
+		}
+	}
+	return count;
+}
+
 bool ccl_ht2_foreach(ccl_ht2 *ht, ccl_dforeach_cb cb, void *user)
 {               
         ccl_ht2_node *node;
 	size_t i;
 
 	for (i = 0; i < ht->size; i++) {
-		node = ccl_ht2_ptr(ht, i);
-		if (node->key == NULL)
+		if (ht->ctrl[i] == CTRL_EMPTY)
 			continue;
+		node = ccl_ht2_ptr(ht, i);
 		if (!cb(node->key, node->value, user))
 			return false;
 	}
@@ -308,28 +526,50 @@ bool ccl_ht2_foreach(ccl_ht2 *ht, ccl_dforeach_cb cb, void *user)
 }
 
 static struct ccl_map_ops map_ops = {
-	(ccl_map_free_cb)ccl_ht2_free,
-	(ccl_map_clear_cb)ccl_ht2_clear,
-	(ccl_map_select_cb)ccl_ht2_select,
-	(ccl_map_insert_cb)ccl_ht2_insert,
-	(ccl_map_delete_cb)ccl_ht2_delete,
-	(ccl_map_foreach_cb)ccl_ht2_foreach,
+	.free		= (ccl_map_free_cb)ccl_ht2_free,
+	.clear		= (ccl_map_clear_cb)ccl_ht2_clear,
+	.select		= (ccl_map_select_cb)ccl_ht2_select,
+	.insert		= (ccl_map_insert_cb)ccl_ht2_insert,
+	.delete		= (ccl_map_delete_cb)ccl_ht2_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_ht2_foreach,
+	.insert_batch	= (ccl_map_insert_batch_cb)ccl_ht2_insert_batch,
+	.select_batch	= (ccl_map_select_batch_cb)ccl_ht2_select_batch,
+	.delete_batch	= (ccl_map_delete_batch_cb)ccl_ht2_delete_batch,
+	.select_hashed	= (ccl_map_select_hashed_cb)ccl_ht2_select_hashed,
+	.insert_hashed	= (ccl_map_insert_hashed_cb)ccl_ht2_insert_hashed,
+	.delete_hashed	= (ccl_map_delete_hashed_cb)ccl_ht2_delete_hashed,
 };
 
-ccl_map *ccl_umap_ht2(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, unsigned size)
+static ccl_map *ccl_umap_ht2_wrap(ccl_ht2 *ht, const ccl_allocator *allocator)
 {
 	ccl_map *map;
 
-	map = malloc(sizeof(*map));
-	if (map == NULL)
+	if (ht == NULL)
 		return NULL;
-	map->obj = ccl_ht2_new(cmp_cb, kfree_cb, vfree_cb, hash_cb, size);
-	if (map->obj == NULL)
+	map = ccl_mem_alloc(allocator, sizeof(*map));
+	if (map == NULL)
 		goto err;
+	map->obj = ht;
 	map->ops = &map_ops;
+	map->allocator = allocator;
 	map->sorted = false;
 	return map;
 err:
-	free(map);
+	ccl_ht2_free(ht);
 	return NULL;
 }
+
+ccl_map *ccl_umap_ht2_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	return ccl_umap_ht2_wrap(ccl_ht2_new_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, flags, allocator), allocator);
+}
+
+ccl_map *ccl_umap_ht2_64(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash64_cb hash_cb, size_t size, unsigned flags, const ccl_allocator *allocator)
+{
+	return ccl_umap_ht2_wrap(ccl_ht2_new64(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, flags, allocator), allocator);
+}
+
+ccl_map *ccl_umap_ht2(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_hash_cb hash_cb, size_t size)
+{
+	return ccl_umap_ht2_ex(cmp_cb, kfree_cb, vfree_cb, hash_cb, size, 0, NULL);
+}
@@ -24,14 +24,17 @@
 
 #include <classic/hb_tree.h>
 
+#include "mapiter.h"
+#include "pool.h"
+
 #define BAL_POS			0x1
 #define BAL_NEG			0x2
 
-static ccl_hbnode *ccl_hbnode_alloc(void* k, void *v)
+static ccl_hbnode *ccl_hbnode_alloc(ccl_hbtree *tree, void* k, void *v)
 {
 	ccl_hbnode *node;
 
-	node = malloc(sizeof(*node));
+	node = ccl_pool_get(tree->pool, tree->allocator, sizeof(*node));
 	if (node == NULL)
 		return NULL;
 	node->key = k;
@@ -43,28 +46,44 @@ static ccl_hbnode *ccl_hbnode_alloc(void* k, void *v)
 	return node;
 }
 
-static void ccl_hbnode_dealloc(ccl_hbnode *node, void **k, void **v)
+static void ccl_hbnode_dealloc(ccl_hbtree *tree, ccl_hbnode *node, void **k, void **v)
 {
 	*k = node->key;
 	*v = node->value;
-	free(node);
+	ccl_pool_put(tree->pool, tree->allocator, node);
 	return;
 }
 
-ccl_hbtree *ccl_hbtree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+ccl_hbtree *ccl_hbtree_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_hbtree *tree;
 
 	if (cmp_cb == NULL)
 		return NULL;
-	tree = malloc(sizeof(*tree));
+	tree = ccl_mem_alloc(allocator, sizeof(*tree));
 	if (tree == NULL)
 		return NULL;
+	tree->root = NULL;
 	tree->cmp = cmp_cb;
 	tree->kfree = kfree_cb;
 	tree->vfree = vfree_cb;
 	tree->count = 0;
+	tree->allocator = allocator;
+	tree->pool = NULL;
+	if (flags & CCL_POOL) {
+		tree->pool = ccl_pool_new_ex(sizeof(ccl_hbnode), allocator);
+		if (tree->pool == NULL)
+			goto err;
+	}
 	return tree;
+err:
+	ccl_mem_free(allocator, tree);
+	return NULL;
+}
+
+ccl_hbtree *ccl_hbtree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+{
+	return ccl_hbtree_new_ex(cmp_cb, kfree_cb, vfree_cb, 0, NULL);
 }
 
 size_t ccl_hbtree_clear(ccl_hbtree *tree)
@@ -73,6 +92,15 @@ size_t ccl_hbtree_clear(ccl_hbtree *tree)
 	void *k, *v;
 	size_t count;
 
+	if (tree->pool != NULL && tree->kfree == NULL && tree->vfree == NULL) {
+		// nothing to release per node, drop the chunks at once
+		count = tree->count;
+		ccl_pool_clear(tree->pool);
+		tree->root = NULL;
+		tree->count = 0;
+		return count;
+	}
+
 	node = tree->root;
 	count = 0;
 	while (node) {
@@ -87,7 +115,7 @@ size_t ccl_hbtree_clear(ccl_hbtree *tree)
 		}
 
 		p = node->parent;
-		ccl_hbnode_dealloc(node, &k, &v);
+		ccl_hbnode_dealloc(tree, node, &k, &v);
 		if (tree->kfree != NULL)
 			tree->kfree(k);
 		if (tree->vfree != NULL)
@@ -110,7 +138,9 @@ size_t ccl_hbtree_clear(ccl_hbtree *tree)
 void ccl_hbtree_free(ccl_hbtree *tree)
 {
 	ccl_hbtree_clear(tree);
-	free(tree);
+	if (tree->pool != NULL)
+		ccl_pool_free(tree->pool);
+	ccl_mem_free(tree->allocator, tree);
 	return;
 }
 
@@ -373,7 +403,7 @@ bool ccl_hbtree_insert(ccl_hbtree *tree, void *k, void *v, void **pv)
 		return false;
 	// empty tree
 	if (tree->root == NULL) {
-		node = ccl_hbnode_alloc(k, v);
+		node = ccl_hbnode_alloc(tree, k, v);
 		if (node == NULL) {
 			return false;
 		} else {
@@ -404,7 +434,7 @@ bool ccl_hbtree_insert(ccl_hbtree *tree, void *k, void *v, void **pv)
 			n = p;
 	}
 
-	node = ccl_hbnode_alloc(k, v);
+	node = ccl_hbnode_alloc(tree, k, v);
 	if (node == NULL)
 		return false;
 	node->parent = p;
@@ -532,7 +562,7 @@ bool ccl_hbtree_unlink(ccl_hbtree *tree, void *key, void **k, void **v)
 	}
 	ccl_hbtree_unlink_ftree(tree, cnode, p, dir);
 out:
-	ccl_hbnode_dealloc(rnode, k, v);
+	ccl_hbnode_dealloc(tree, rnode, k, v);
 	tree->count--;
 	return true;
 }
@@ -572,6 +602,28 @@ static ccl_hbnode *ccl_hbnode_next(ccl_hbnode *node)
 	return n;
 }
 
+static ccl_hbnode *ccl_hbnode_prev(ccl_hbnode *node)
+{
+	ccl_hbnode *n;
+
+	if (node->left) {
+		n = node->left;
+		while (n->right)
+			n = n->right;
+	} else {
+		ccl_hbnode *p;
+
+		n = node;
+		p = n->parent;
+		while (p && p->left == n) {
+			n = p;
+			p = p->parent;
+		}
+		n = p;
+	}
+	return n;
+}
+
 bool ccl_hbtree_foreach(ccl_hbtree *tree, ccl_dforeach_cb cb, void *user)
 {
 	ccl_hbnode *node;
@@ -588,29 +640,249 @@ bool ccl_hbtree_foreach(ccl_hbtree *tree, ccl_dforeach_cb cb, void *user)
 	return true;
 }
 
+/* nodes for sorted keys, linked through ->right; all or nothing */
+static ccl_hbnode *ccl_hbtree_build_list(ccl_hbtree *tree, void **keys, void **values, size_t n)
+{
+	ccl_hbnode *head, **pnode, *node;
+	void *k, *v;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (keys[i] == NULL || (i > 0 && tree->cmp(keys[i - 1], keys[i]) >= 0))
+			return NULL;
+	}
+	head = NULL;
+	pnode = &head;
+	for (i = 0; i < n; i++) {
+		node = ccl_hbnode_alloc(tree, keys[i], values ? values[i] : NULL);
+		if (node == NULL)
+			goto err;
+		*pnode = node;
+		pnode = &node->right;
+	}
+	return head;
+err:
+	while (head != NULL) {
+		node = head->right;
+		ccl_hbnode_dealloc(tree, head, &k, &v);
+		head = node;
+	}
+	return NULL;
+}
+
+/* in-order build from the node list, left subtree gets the larger half */
+static ccl_hbnode *ccl_hbtree_build_subtree(ccl_hbnode **list, size_t n, unsigned *height)
+{
+	ccl_hbnode *node, *left;
+	unsigned lh, rh;
+
+	if (n == 0) {
+		*height = 0;
+		return NULL;
+	}
+	left = ccl_hbtree_build_subtree(list, n / 2, &lh);
+	node = *list;
+	*list = node->right;
+	node->left = left;
+	if (left != NULL)
+		left->parent = node;
+	node->right = ccl_hbtree_build_subtree(list, n - n / 2 - 1, &rh);
+	if (node->right != NULL)
+		node->right->parent = node;
+	node->balance = (lh > rh ? BAL_NEG : (lh < rh ? BAL_POS : 0x0));
+	*height = (lh > rh ? lh : rh) + 1;
+	return node;
+}
+
+bool ccl_hbtree_build_sorted(ccl_hbtree *tree, void **keys, void **values, size_t n)
+{
+	ccl_hbnode *list;
+	unsigned height;
+
+	if (tree->root != NULL)
+		return false;
+	if (n == 0)
+		return true;
+	list = ccl_hbtree_build_list(tree, keys, values, n);
+	if (list == NULL)
+		return false;
+	tree->root = ccl_hbtree_build_subtree(&list, n, &height);
+	tree->root->parent = NULL;
+	tree->count = n;
+	return true;
+}
+
+/* first node with key >= k, or > k when strict */
+static ccl_hbnode *ccl_hbtree_bound_node(ccl_hbtree *tree, const void *k, bool strict)
+{
+	ccl_hbnode *node, *bound;
+	int ret;
+
+	bound = NULL;
+	node = tree->root;
+	while (node) {
+		ret = tree->cmp(k, node->key);
+		if (ret == 0 && !strict) {
+			bound = node;
+			break;
+		}
+		if (ret < 0) {
+			bound = node;
+			node = node->left;
+		} else {
+			node = node->right;
+		}
+	}
+	return bound;
+}
+
+bool ccl_hbtree_lower_bound(ccl_hbtree *tree, const void *k, void **key, void **value)
+{
+	ccl_hbnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_hbtree_bound_node(tree, k, false);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+bool ccl_hbtree_upper_bound(ccl_hbtree *tree, const void *k, void **key, void **value)
+{
+	ccl_hbnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_hbtree_bound_node(tree, k, true);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+/* entries with lo <= key < hi in order, a NULL bound is open */
+bool ccl_hbtree_range_foreach(ccl_hbtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	ccl_hbnode *node;
+
+	if (lo != NULL) {
+		node = ccl_hbtree_bound_node(tree, lo, false);
+	} else {
+		node = tree->root;
+		while (node && node->left)
+			node = node->left;
+	}
+	for (; node != NULL; node = ccl_hbnode_next(node)) {
+		if (hi != NULL && tree->cmp(node->key, hi) >= 0)
+			break;
+		if (!cb(node->key, node->value, user))
+			return false;
+	}
+	return true;
+}
+
+void ccl_hbtree_iter_init(ccl_hbtree_iter *it, ccl_hbtree *tree)
+{
+	it->node = NULL;
+	it->tree = tree;
+	return;
+}
+
+bool ccl_hbtree_iter_begin(ccl_hbtree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->left)
+		it->node = it->node->left;
+	return (it->node != NULL);
+}
+
+bool ccl_hbtree_iter_end(ccl_hbtree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->right)
+		it->node = it->node->right;
+	return (it->node != NULL);
+}
+
+/* position on the first entry with key >= k */
+bool ccl_hbtree_iter_seek(ccl_hbtree_iter *it, const void *k)
+{
+	it->node = (k != NULL ? ccl_hbtree_bound_node(it->tree, k, false) : NULL);
+	return (it->node != NULL);
+}
+
+bool ccl_hbtree_iter_next(ccl_hbtree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_hbnode_next(it->node);
+	return (it->node != NULL);
+}
+
+bool ccl_hbtree_iter_prev(ccl_hbtree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_hbnode_prev(it->node);
+	return (it->node != NULL);
+}
+
+void *ccl_hbtree_iter_key(ccl_hbtree_iter *it)
+{
+	return it->node->key;
+}
+
+void *ccl_hbtree_iter_value(ccl_hbtree_iter *it)
+{
+	return it->node->value;
+}
+
+CCL_MAP_ITER_OPS(ccl_hbtree, ccl_hbtree_iter)
+
 static struct ccl_map_ops map_ops = {
-	(ccl_map_free_cb)ccl_hbtree_free,
-	(ccl_map_clear_cb)ccl_hbtree_clear,
-	(ccl_map_select_cb)ccl_hbtree_select,
-	(ccl_map_insert_cb)ccl_hbtree_insert,
-	(ccl_map_delete_cb)ccl_hbtree_delete,
-	(ccl_map_foreach_cb)ccl_hbtree_foreach,
+	.free		= (ccl_map_free_cb)ccl_hbtree_free,
+	.clear		= (ccl_map_clear_cb)ccl_hbtree_clear,
+	.select		= (ccl_map_select_cb)ccl_hbtree_select,
+	.insert		= (ccl_map_insert_cb)ccl_hbtree_insert,
+	.delete		= (ccl_map_delete_cb)ccl_hbtree_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_hbtree_foreach,
+	.build_sorted	= (ccl_map_build_cb)ccl_hbtree_build_sorted,
+	.lower_bound	= (ccl_map_bound_cb)ccl_hbtree_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_hbtree_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_hbtree_range_foreach,
+	.iter_begin	= ccl_hbtree_map_iter_begin,
+	.iter_end	= ccl_hbtree_map_iter_end,
+	.iter_seek	= ccl_hbtree_map_iter_seek,
+	.iter_next	= ccl_hbtree_map_iter_next,
+	.iter_prev	= ccl_hbtree_map_iter_prev,
+	.iter_key	= ccl_hbtree_map_iter_key,
+	.iter_value	= ccl_hbtree_map_iter_value,
 };
 
-ccl_map *ccl_smap_hbtree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+ccl_map *ccl_smap_hbtree_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_map *map;
 
-	map = malloc(sizeof(*map));
+	map = ccl_mem_alloc(allocator, sizeof(*map));
 	if (map == NULL)
 		return NULL;
-	map->obj = ccl_hbtree_new(cmp_cb, kfree_cb, vfree_cb);
+	map->obj = ccl_hbtree_new_ex(cmp_cb, kfree_cb, vfree_cb, flags, allocator);
 	if (map->obj == NULL)
 		goto err;
 	map->ops = &map_ops;
+	map->allocator = allocator;
 	map->sorted = true;
 	return map;
 err:
-	free(map);
+	ccl_mem_free(allocator, map);
 	return NULL;
 }
+
+ccl_map *ccl_smap_hbtree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+{
+	return ccl_smap_hbtree_ex(cmp_cb, kfree_cb, vfree_cb, 0, NULL);
+}
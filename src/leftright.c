@@ -0,0 +1,261 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: left-right concurrency control over two copies of any map,
+         wait-free readers with epoch based reader tracking
+   Ref:  [Ramalhete 2015], [McKenney 2001].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <classic/map.h>
+#include <classic/epoch.h>
+
+#include "allocator.h"
+#include "lock.h"
+
+/*
+ * Readers load lr->read inside an epoch section and use that copy only.
+ * A writer changes the other copy, points lr->read at it and waits in
+ * ccl_epoch_synchronize() until every section that could have loaded the
+ * old index is over; the old copy then has no readers and gets the same
+ * change.  Between writes both copies hold the same entries.  Many
+ * readers may run the backend's lookups on one copy at the same time,
+ * which is why map.h rules out backends that write on select.  Readers
+ * write nothing shared but their own epoch record, so they scale with the
+ * number of threads; the epoch sections replace the per-copy read
+ * indicators of the original algorithm.
+ */
+typedef struct ccl_leftright_t {
+	ccl_map *map[2];
+	unsigned read;			// index of the copy readers use
+	ccl_lock lock;			// serialises writers
+	const ccl_allocator *allocator;
+} ccl_leftright;
+
+// move readers to the copy just written, the other one is idle on return
+static void ccl_leftright_switch(ccl_leftright *lr, unsigned w)
+{
+	// seq_cst against the reader's fence: either the scan in
+	// ccl_epoch_synchronize() sees the reader's section or the reader
+	// loads the new index
+	__atomic_store_n(&lr->read, w, __ATOMIC_SEQ_CST);
+	ccl_epoch_synchronize();
+	return;
+}
+
+static void ccl_leftright_free(ccl_leftright *lr)
+{
+	ccl_map_free(lr->map[0]);
+	ccl_map_free(lr->map[1]);
+	ccl_lock_destroy(&lr->lock);
+	ccl_mem_free(lr->allocator, lr);
+	return;
+}
+
+static size_t ccl_leftright_clear(ccl_leftright *lr)
+{
+	size_t count;
+	unsigned w;
+
+	ccl_lock_acquire(&lr->lock);
+	w = !lr->read;
+	count = ccl_map_clear(lr->map[w]);
+	ccl_leftright_switch(lr, w);
+	ccl_map_clear(lr->map[!w]);
+	ccl_lock_release(&lr->lock);
+	return count;
+}
+
+static bool ccl_leftright_select(ccl_leftright *lr, const void *k, void **v)
+{
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = ccl_map_select(lr->map[__atomic_load_n(&lr->read, __ATOMIC_ACQUIRE)], k, v);
+	ccl_epoch_exit();
+	return ret;
+}
+
+static bool ccl_leftright_insert(ccl_leftright *lr, const void *k, void *v, void **pv)
+{
+	void *slot;
+	unsigned w;
+
+	*pv = NULL;
+	ccl_lock_acquire(&lr->lock);
+	w = !lr->read;
+	if (!ccl_map_insert(lr->map[w], k, v, &slot))
+		goto err;	// present in both copies, or no memory
+	ccl_leftright_switch(lr, w);
+	if (!ccl_map_insert(lr->map[!w], k, v, &slot)) {
+		// take k back out of the first copy so that both stay equal
+		ccl_leftright_switch(lr, !w);
+		ccl_map_delete(lr->map[w], k);
+		goto err;
+	}
+	ccl_lock_release(&lr->lock);
+	return true;
+err:
+	ccl_lock_release(&lr->lock);
+	return false;
+}
+
+static bool ccl_leftright_delete(ccl_leftright *lr, const void *k)
+{
+	unsigned w;
+
+	ccl_lock_acquire(&lr->lock);
+	w = !lr->read;
+	if (!ccl_map_delete(lr->map[w], k)) {
+		ccl_lock_release(&lr->lock);
+		return false;
+	}
+	ccl_leftright_switch(lr, w);
+	ccl_map_delete(lr->map[!w], k);
+	ccl_lock_release(&lr->lock);
+	return true;
+}
+
+static bool ccl_leftright_foreach(ccl_leftright *lr, ccl_dforeach_cb cb, void *user)
+{
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = ccl_map_foreach(lr->map[__atomic_load_n(&lr->read, __ATOMIC_ACQUIRE)], cb, user);
+	ccl_epoch_exit();
+	return ret;
+}
+
+static bool ccl_leftright_lower_bound(ccl_leftright *lr, const void *k, void **key, void **value)
+{
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = ccl_map_lower_bound(lr->map[__atomic_load_n(&lr->read, __ATOMIC_ACQUIRE)], k, key, value);
+	ccl_epoch_exit();
+	return ret;
+}
+
+static bool ccl_leftright_upper_bound(ccl_leftright *lr, const void *k, void **key, void **value)
+{
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = ccl_map_upper_bound(lr->map[__atomic_load_n(&lr->read, __ATOMIC_ACQUIRE)], k, key, value);
+	ccl_epoch_exit();
+	return ret;
+}
+
+static bool ccl_leftright_range_foreach(ccl_leftright *lr, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = ccl_map_range_foreach(lr->map[__atomic_load_n(&lr->read, __ATOMIC_ACQUIRE)], lo, hi, cb, user);
+	ccl_epoch_exit();
+	return ret;
+}
+
+// one section for the whole batch, and the backend's batched lookup
+static size_t ccl_leftright_select_batch(ccl_leftright *lr, void **keys, size_t n, void **values)
+{
+	size_t i, count;
+
+	if (!ccl_epoch_enter()) {
+		for (i = 0; i < n; i++)
+			values[i] = NULL;
+		return 0;
+	}
+	count = ccl_map_select_batch(lr->map[__atomic_load_n(&lr->read, __ATOMIC_ACQUIRE)], keys, n, values);
+	ccl_epoch_exit();
+	return count;
+}
+
+static bool ccl_leftright_select_hashed(ccl_leftright *lr, const void *k, uint64_t hash, void **v)
+{
+	bool ret;
+
+	if (!ccl_epoch_enter())
+		return false;
+	ret = ccl_map_select_hashed(lr->map[__atomic_load_n(&lr->read, __ATOMIC_ACQUIRE)], k, hash, v);
+	ccl_epoch_exit();
+	return ret;
+}
+
+static struct ccl_map_ops map_ops = {
+	.free		= (ccl_map_free_cb)ccl_leftright_free,
+	.clear		= (ccl_map_clear_cb)ccl_leftright_clear,
+	.select		= (ccl_map_select_cb)ccl_leftright_select,
+	.insert		= (ccl_map_insert_cb)ccl_leftright_insert,
+	.delete		= (ccl_map_delete_cb)ccl_leftright_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_leftright_foreach,
+	.lower_bound	= (ccl_map_bound_cb)ccl_leftright_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_leftright_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_leftright_range_foreach,
+	.select_batch	= (ccl_map_select_batch_cb)ccl_leftright_select_batch,
+	.select_hashed	= (ccl_map_select_hashed_cb)ccl_leftright_select_hashed,
+};
+
+ccl_map *ccl_map_leftright(ccl_map_factory_cb factory, void *user)
+{
+	ccl_leftright *lr;
+	ccl_map *map;
+	ccl_map *copy[2];
+
+	copy[0] = factory(user);
+	if (copy[0] == NULL)
+		return NULL;
+	copy[1] = factory(user);
+	if (copy[1] == NULL)
+		goto err_copy;
+	lr = ccl_mem_alloc(copy[0]->allocator, sizeof(*lr));
+	if (lr == NULL)
+		goto err_lr;
+	map = ccl_mem_alloc(copy[0]->allocator, sizeof(*map));
+	if (map == NULL)
+		goto err_map;
+	if (!ccl_lock_init(&lr->lock))
+		goto err_lock;
+	lr->map[0] = copy[0];
+	lr->map[1] = copy[1];
+	lr->read = 0;
+	lr->allocator = copy[0]->allocator;
+	map->obj = lr;
+	map->ops = &map_ops;
+	map->allocator = copy[0]->allocator;
+	map->sorted = copy[0]->sorted;
+	return map;
+err_lock:
+	ccl_mem_free(copy[0]->allocator, map);
+err_map:
+	ccl_mem_free(copy[0]->allocator, lr);
+err_lr:
+	ccl_map_free(copy[1]);
+err_copy:
+	ccl_map_free(copy[0]);
+	return NULL;
+}
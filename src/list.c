@@ -21,12 +21,13 @@
 #include <string.h>
 
 #include "list.h"
+#include "pool.h"
 
-static ccl_list_node *_ccl_list_node_new(void *v)
+static ccl_list_node *_ccl_list_node_new(ccl_list *list, void *v)
 {
 	ccl_list_node *node;
 
-        node = malloc(sizeof(*node));
+        node = ccl_pool_get(list->pool, list->allocator, sizeof(*node));
 	if (node == NULL)
 		return NULL;
 	node->prev = NULL;
@@ -35,9 +36,9 @@ static ccl_list_node *_ccl_list_node_new(void *v)
 	return node;
 }
 
-static void _ccl_list_node_free(ccl_list_node *node)
+static void _ccl_list_node_free(ccl_list *list, ccl_list_node *node)
 {       
-	free(node);
+	ccl_pool_put(list->pool, list->allocator, node);
 	return;
 }
 
@@ -77,30 +78,51 @@ void ccl_list_init(ccl_list *list, ccl_cmp_cb cmp_cb, ccl_free_cb vfree_cb)
 	list->vfree = vfree_cb;
 	list->count = 0;
 	list->sorted = true;
+	list->pool = NULL;
+	list->allocator = NULL;
         return;
 }
 
-ccl_list *ccl_list_new(ccl_cmp_cb cmp_cb, ccl_free_cb vfree_cb)
+ccl_list *ccl_list_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb vfree_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_list *list;
 
-	list = malloc(sizeof(*list));
+	list = ccl_mem_alloc(allocator, sizeof(*list));
 	if (list == NULL)
 		return NULL;
 	ccl_list_init(list, cmp_cb, vfree_cb);
-        return list;
+	list->allocator = allocator;
+	if (flags & CCL_POOL) {
+		list->pool = ccl_pool_new_ex(sizeof(ccl_list_node), allocator);
+		if (list->pool == NULL)
+			goto err;
+	}
+	return list;
+err:
+	ccl_mem_free(allocator, list);
+	return NULL;
+}
+
+ccl_list *ccl_list_new(ccl_cmp_cb cmp_cb, ccl_free_cb vfree_cb)
+{
+	return ccl_list_new_ex(cmp_cb, vfree_cb, 0, NULL);
 }
 
 void ccl_list_clear(ccl_list *list)
 {
 	ccl_list_node *node, *next;
 
-	node = list->head;
+	if (list->pool != NULL && list->vfree == NULL) {
+		ccl_pool_clear(list->pool);	// drop the chunks at once
+		node = NULL;
+	} else {
+		node = list->head;
+	}
 	while (node) {
 		next = node->next;
 		if (list->vfree != NULL)
 			list->vfree(node->value);
-		_ccl_list_node_free(node);
+		_ccl_list_node_free(list, node);
 		node = next;
 	}
 	list->head = list->tail = NULL;
@@ -111,7 +133,9 @@ void ccl_list_clear(ccl_list *list)
 void ccl_list_free(ccl_list *list)
 {
 	ccl_list_clear(list);
-	free(list);
+	if (list->pool != NULL)
+		ccl_pool_free(list->pool);
+	ccl_mem_free(list->allocator, list);
 	return;
 }
 
@@ -119,7 +143,7 @@ bool ccl_list_prepend(ccl_list *list, void *v)
 {       
 	ccl_list_node *node;
         
-	node = _ccl_list_node_new(v);
+	node = _ccl_list_node_new(list, v);
 	if (node == NULL)
 		return false;
 	_ccl_list_node_prepend(list, node);
@@ -130,7 +154,7 @@ bool ccl_list_append(ccl_list *list, void *v)
 {
 	ccl_list_node *node;
 
-	node = _ccl_list_node_new(v);
+	node = _ccl_list_node_new(list, v);
 	if (node == NULL)
 		return false;
 	_ccl_list_node_append(list, node);
@@ -157,7 +181,7 @@ bool ccl_list_pop_tail(ccl_list *list, void **v)
 		list->tail->next = NULL;
 	}
 	list->count--;
-	_ccl_list_node_free(node);
+	_ccl_list_node_free(list, node);
 	return true;
 }
 
@@ -181,7 +205,7 @@ bool ccl_list_pop_head(ccl_list *list, void **v)
 		list->head->prev = NULL;
 	}
 	list->count--;
-	_ccl_list_node_free(node);
+	_ccl_list_node_free(list, node);
 	return true;
 }
 
@@ -196,24 +220,105 @@ bool ccl_list_foreach(ccl_list *list, ccl_sforeach_cb cb, void *user)
 	return true;
 }
 
+/*
+ * Stable merge of two NULL-terminated runs linked through ->next; on equal
+ * keys the item from a, the earlier run, goes first.
+ */
+static ccl_list_node *_ccl_list_merge(ccl_cmp_cb cmp, ccl_list_node *a, ccl_list_node *b)
+{
+	ccl_list_node head, *tail;
+
+	tail = &head;
+	while (a && b) {
+		if (cmp(b->value, a->value) < 0) {
+			tail->next = b;
+			b = b->next;
+		} else {
+			tail->next = a;
+			a = a->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = (a ? a : b);
+	return head.next;
+}
+
+/*
+ * Detach the natural run starting at node: the longest non-descending
+ * stretch, or a strictly descending one which is reversed in place (that
+ * keeps the sort stable).  *rest receives the node after the run.
+ */
+static ccl_list_node *_ccl_list_run(ccl_cmp_cb cmp, ccl_list_node *node, ccl_list_node **rest)
+{
+	ccl_list_node *run, *next;
+
+	next = node->next;
+	if (next && cmp(next->value, node->value) < 0) {
+		run = node;
+		run->next = NULL;
+		node = next;
+		while (node) {
+			next = node->next;
+			node->next = run;
+			run = node;
+			if (next == NULL || cmp(next->value, node->value) >= 0)
+				break;
+			node = next;
+		}
+		*rest = next;
+		return run;
+	}
+	run = node;
+	while (next && cmp(next->value, node->value) >= 0) {
+		node = next;
+		next = node->next;
+	}
+	node->next = NULL;
+	*rest = next;
+	return run;
+}
+
+/*
+ * Bottom-up natural merge sort.  Runs are merged like a binary counter:
+ * pending[i] holds the merge of 2^i runs, so a list with r runs takes
+ * O(n log r) compares and an already sorted one a single pass.  Nodes are
+ * relinked in place, nothing is allocated.
+ */
 bool ccl_list_sort(ccl_list *list)
 {
-	ccl_list_node *node, *node2;
-	void *v;
+	ccl_list_node *pending[sizeof(size_t) * 8];
+	ccl_list_node *node, *run, *prev;
+	size_t i, top;
 
 	if (list->cmp == NULL)
 		return false;
 	if (list->sorted)
 		return true;
-	for (node = list->head; node && node->value; node = node->next) {
-		for (node2 = node->next; node2 && node2->value; node2 = node2->next) {
-			if (list->cmp(node->value, node2->value) <= 0)
-				continue;
-			v = node->value;
-			node->value = node2->value;
-			node2->value = v;
+	top = 0;
+	node = list->head;
+	while (node) {
+		run = _ccl_list_run(list->cmp, node, &node);
+		for (i = 0; i < top && pending[i]; i++) {
+			run = _ccl_list_merge(list->cmp, pending[i], run);
+			pending[i] = NULL;
 		}
+		if (i == top)
+			top++;
+		pending[i] = run;
 	}
+	run = NULL;
+	for (i = 0; i < top; i++) {
+		if (pending[i])
+			run = (run ? _ccl_list_merge(list->cmp, pending[i], run) : pending[i]);
+	}
+	// restore the back links
+	prev = NULL;
+	for (node = run; node; node = node->next) {
+		node->prev = prev;
+		prev = node;
+	}
+	list->head = run;
+	list->tail = prev;
 	list->sorted = true;
 	return true;
 }
@@ -233,21 +338,27 @@ bool ccl_list_sorted(ccl_list *list)
 	return list->sorted;
 }
 
+void ccl_list_iter_init(ccl_list_iter *it, ccl_list *list)
+{
+	it->node = list->head;
+	it->list = list;
+	return;
+}
+
 ccl_list_iter *ccl_list_iter_new(ccl_list *list)
 {
 	ccl_list_iter *it;
 
-	it = malloc(sizeof(*it));
+	it = ccl_mem_alloc(list->allocator, sizeof(*it));
 	if (it == NULL)
 		return NULL;
-	it->node = list->head;
-	it->list = list;
+	ccl_list_iter_init(it, list);
 	return it;
 }
 
 void ccl_list_iter_free(ccl_list_iter *it)
 {
-	free(it);
+	ccl_mem_free(it->list->allocator, it);
 	return;
 }
 
@@ -287,7 +398,7 @@ bool ccl_list_iter_prevn(ccl_list_iter *it, size_t n)
 
 bool ccl_list_iter_prev(ccl_list_iter *it)
 {
-	if (it->node->prev == NULL)
+	if (it->node == NULL || it->node->prev == NULL)
 		return false;
 	it->node = it->node->prev;
 	return true;
@@ -312,7 +423,7 @@ bool ccl_list_iter_nextn(ccl_list_iter *it, size_t n)
 
 bool ccl_list_iter_next(ccl_list_iter *it)
 {
-	if (it->node->next == NULL)
+	if (it->node == NULL || it->node->next == NULL)
 		return false;
 	it->node = it->node->next;
 	return true;
@@ -335,9 +446,10 @@ void *ccl_list_iter_unlink(ccl_list_iter *it)
 	if (node->next)
 		node->next->prev = node->prev;
 	list->count--;
+	it->node = node->next;		// like the vector, move on to the following item
 	node->next = node->prev = NULL;
 	value = node->value;
-	_ccl_list_node_free(node);
+	_ccl_list_node_free(list, node);
 	return value;
 }
 
@@ -350,7 +462,6 @@ void ccl_list_iter_delete(ccl_list_iter *it)
 	v = ccl_list_iter_unlink(it);
 	if (list->vfree)
 		list->vfree(v);
-	ccl_list_iter_free(it);
 	return;
 }
 
@@ -359,11 +470,11 @@ bool ccl_list_iter_insertb(ccl_list_iter *it, void *v)	/* before */
 	ccl_list *list;
 	ccl_list_node *node, *node2;
 
-	node = _ccl_list_node_new(v);
+	list = it->list;
+	node = _ccl_list_node_new(list, v);
 	if (node == NULL)
 		return false;
 
-	list = it->list;
 	node2 = it->node;
 	if (node2->prev == NULL)
 		list->head = node;
@@ -382,11 +493,11 @@ bool ccl_list_iter_inserta(ccl_list_iter *it, void *v)	/* after */
 	ccl_list *list;
 	ccl_list_node *node, *node2;
 
-	node = _ccl_list_node_new(v);
+	list = it->list;
+	node = _ccl_list_node_new(list, v);
 	if (node == NULL)
 		return false;
 
-	list = it->list;
 	node2 = it->node;
 	if (node2->next == NULL)
 		list->tail = node;
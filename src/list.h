@@ -25,6 +25,7 @@
 #include <stdbool.h>
 
 #include <classic/common.h>
+#include <classic/pool.h>
 
 typedef struct ccl_list_node_t {
 	struct ccl_list_node_t *prev;
@@ -38,9 +39,12 @@ typedef struct ccl_list_t {
 	ccl_free_cb vfree;
 	ccl_cmp_cb cmp;
 	size_t count;
+	ccl_pool *pool;			// node pool, NULL without CCL_POOL
+	const ccl_allocator *allocator;
 	bool sorted;
 } ccl_list;
 
+// must match the public definition in <classic/list.h>
 typedef struct ccl_list_iter_t {
 	ccl_list_node *node;
 	ccl_list *list;
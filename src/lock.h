@@ -0,0 +1,48 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef _CCL_LOCK_H
+#define _CCL_LOCK_H
+
+#include <stdbool.h>
+
+/*
+ * Mutual exclusion for the concurrent containers.  Without pthreads the
+ * library is single-threaded and the locks compile to nothing.
+ */
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+
+typedef pthread_mutex_t ccl_lock;
+
+#define ccl_lock_init(l)		(pthread_mutex_init((l), NULL) == 0)
+#define ccl_lock_destroy(l)		pthread_mutex_destroy(l)
+#define ccl_lock_acquire(l)		pthread_mutex_lock(l)
+#define ccl_lock_release(l)		pthread_mutex_unlock(l)
+#else
+typedef char ccl_lock;
+
+#define ccl_lock_init(l)		((void)(l), true)
+#define ccl_lock_destroy(l)		((void)(l))
+#define ccl_lock_acquire(l)		((void)(l))
+#define ccl_lock_release(l)		((void)(l))
+#endif
+
+#endif
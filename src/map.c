@@ -20,9 +20,143 @@
 
 #include <classic/map.h>
 
+#include "allocator.h"
+
 void ccl_map_free(ccl_map *map)
 {
 	map->ops->free(map->obj);
-	free(map);
+	ccl_mem_free(map->allocator, map);
 	return;
 }
+
+/*
+ * Load n strictly ascending keys (values may be NULL) into an empty map.
+ * Sorted backends build their structure directly in O(n) and keep nothing
+ * on failure; the others fall back to inserting one key at a time and may
+ * keep the keys inserted before the failing one.
+ */
+bool ccl_map_build_sorted(ccl_map *map, void **keys, void **values, size_t n)
+{
+	void *pv;
+	size_t i;
+
+	if (map->ops->build_sorted != NULL)
+		return map->ops->build_sorted(map->obj, keys, values, n);
+	for (i = 0; i < n; i++) {
+		if (!map->ops->insert(map->obj, keys[i], (values ? values[i] : NULL), &pv))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Ordered queries, sorted maps only: the first entry with key >= k
+ * (lower) or key > k (upper), and a scan of lo <= key < hi where a NULL
+ * bound is open.  Unsorted maps always return false.
+ */
+bool ccl_map_lower_bound(ccl_map *map, const void *k, void **key, void **value)
+{
+	if (map->ops->lower_bound == NULL)
+		return false;
+	return map->ops->lower_bound(map->obj, k, key, value);
+}
+
+bool ccl_map_upper_bound(ccl_map *map, const void *k, void **key, void **value)
+{
+	if (map->ops->upper_bound == NULL)
+		return false;
+	return map->ops->upper_bound(map->obj, k, key, value);
+}
+
+bool ccl_map_range_foreach(ccl_map *map, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	if (map->ops->range_foreach == NULL)
+		return false;
+	return map->ops->range_foreach(map->obj, lo, hi, cb, user);
+}
+
+/*
+ * Stack-allocated ordered iterator over a sorted map.  Unsorted maps have
+ * no iterator ops and return false; the iterator is invalidated by any
+ * modification of the map.
+ */
+bool ccl_map_iter_init(ccl_map_iter *it, ccl_map *map)
+{
+	it->node = NULL;
+	it->obj = map->obj;
+	it->map = map;
+	return (map->ops->iter_begin != NULL);
+}
+
+/*
+ * Batched insert/select/delete.  The hash tables hash and prefetch a window
+ * of keys before resolving it; other backends run one key at a time.  Each
+ * returns how many keys were inserted, found or deleted; select stores
+ * NULL for keys that are missing.
+ */
+size_t ccl_map_insert_batch(ccl_map *map, void **keys, void **values, size_t n)
+{
+	size_t i, count;
+	void *pv;
+
+	if (map->ops->insert_batch != NULL)
+		return map->ops->insert_batch(map->obj, keys, values, n);
+	for (i = count = 0; i < n; i++) {
+		if (map->ops->insert(map->obj, keys[i], (values ? values[i] : NULL), &pv))
+			count++;
+	}
+	return count;
+}
+
+size_t ccl_map_select_batch(ccl_map *map, void **keys, size_t n, void **values)
+{
+	size_t i, count;
+
+	if (map->ops->select_batch != NULL)
+		return map->ops->select_batch(map->obj, keys, n, values);
+	for (i = count = 0; i < n; i++) {
+		if (map->ops->select(map->obj, keys[i], &values[i]))
+			count++;
+		else
+			values[i] = NULL;
+	}
+	return count;
+}
+
+size_t ccl_map_delete_batch(ccl_map *map, void **keys, size_t n)
+{
+	size_t i, count;
+
+	if (map->ops->delete_batch != NULL)
+		return map->ops->delete_batch(map->obj, keys, n);
+	for (i = count = 0; i < n; i++) {
+		if (map->ops->delete(map->obj, keys[i]))
+			count++;
+	}
+	return count;
+}
+
+/*
+ * Lookups with a hash the caller already has, equal to the map's hash
+ * callback for k.  Backends that do not hash ignore it.
+ */
+bool ccl_map_select_hashed(ccl_map *map, const void *k, uint64_t hash, void **v)
+{
+	if (map->ops->select_hashed == NULL)
+		return map->ops->select(map->obj, k, v);
+	return map->ops->select_hashed(map->obj, k, hash, v);
+}
+
+bool ccl_map_insert_hashed(ccl_map *map, const void *k, void *v, uint64_t hash, void **pv)
+{
+	if (map->ops->insert_hashed == NULL)
+		return map->ops->insert(map->obj, k, v, pv);
+	return map->ops->insert_hashed(map->obj, k, v, hash, pv);
+}
+
+bool ccl_map_delete_hashed(ccl_map *map, const void *k, uint64_t hash)
+{
+	if (map->ops->delete_hashed == NULL)
+		return map->ops->delete(map->obj, k);
+	return map->ops->delete_hashed(map->obj, k, hash);
+}
@@ -0,0 +1,72 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef _CCL_MAPITER_H
+#define _CCL_MAPITER_H
+
+#include <stdbool.h>
+
+#include <classic/map.h>
+
+/*
+ * ccl_map_iter ops for a backend whose iterator holds a node and a tree.
+ * Each op copies the position into an iterator of the backend's own type,
+ * runs the backend function on it and stores the position back, so that
+ * neither struct is ever accessed through the other; the designated
+ * initializers stop the build if the backend iterator changes shape.
+ */
+#define CCL_MAP_ITER_MOVE(prefix, iter_type, op)				\
+static bool prefix##_map_iter_##op(ccl_map_iter *mit)				\
+{										\
+	iter_type it = { .node = mit->node, .tree = mit->obj };		\
+	bool ret;								\
+										\
+	ret = prefix##_iter_##op(&it);						\
+	mit->node = it.node;							\
+	return ret;								\
+}
+
+#define CCL_MAP_ITER_GET(prefix, iter_type, op)				\
+static void *prefix##_map_iter_##op(ccl_map_iter *mit)				\
+{										\
+	iter_type it = { .node = mit->node, .tree = mit->obj };		\
+										\
+	return prefix##_iter_##op(&it);						\
+}
+
+#define CCL_MAP_ITER_OPS(prefix, iter_type)					\
+CCL_MAP_ITER_MOVE(prefix, iter_type, begin)					\
+CCL_MAP_ITER_MOVE(prefix, iter_type, end)					\
+CCL_MAP_ITER_MOVE(prefix, iter_type, next)					\
+CCL_MAP_ITER_MOVE(prefix, iter_type, prev)					\
+CCL_MAP_ITER_GET(prefix, iter_type, key)					\
+CCL_MAP_ITER_GET(prefix, iter_type, value)					\
+										\
+static bool prefix##_map_iter_seek(ccl_map_iter *mit, const void *k)		\
+{										\
+	iter_type it = { .node = mit->node, .tree = mit->obj };		\
+	bool ret;								\
+										\
+	ret = prefix##_iter_seek(&it, k);					\
+	mit->node = it.node;							\
+	return ret;								\
+}
+
+#endif
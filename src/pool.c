@@ -0,0 +1,132 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Algo: fixed-size object pool (slab), nodes carved from chunks
+         with an intrusive free list.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#include <stdint.h>
+
+#include <classic/pool.h>
+
+#include "allocator.h"
+
+/*
+ * Objects are carved from chunks that double in size up to MAX_CHUNK_OBJS
+ * objects.  A released object goes to the head of the free list and is
+ * reused first; chunks themselves are only returned by ccl_pool_clear()
+ * and ccl_pool_free(), which release every object at once.
+ */
+
+#define POOL_ALIGN		16
+#define MIN_CHUNK_OBJS		32
+#define MAX_CHUNK_OBJS		4096
+
+typedef struct ccl_pool_chunk_t {
+	struct ccl_pool_chunk_t *next;
+} ccl_pool_chunk;
+
+#define CHUNK_HDR_SIZE		((sizeof(ccl_pool_chunk) + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1))
+
+ccl_pool *ccl_pool_new_ex(size_t size, const ccl_allocator *allocator)
+{
+	ccl_pool *pool;
+
+	if (size == 0 || size > SIZE_MAX / MAX_CHUNK_OBJS)
+		return NULL;
+	pool = ccl_mem_alloc(allocator, sizeof(*pool));
+	if (pool == NULL)
+		return NULL;
+	if (size < sizeof(void *))
+		size = sizeof(void *);
+	pool->size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	pool->free = NULL;
+	pool->chunks = NULL;
+	pool->cur = NULL;
+	pool->end = NULL;
+	pool->nobjs = MIN_CHUNK_OBJS;
+	pool->allocator = allocator;
+	return pool;
+}
+
+ccl_pool *ccl_pool_new(size_t size)
+{
+	return ccl_pool_new_ex(size, NULL);
+}
+
+void ccl_pool_clear(ccl_pool *pool)
+{
+	ccl_pool_chunk *chunk, *next;
+
+	for (chunk = pool->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		ccl_mem_free(pool->allocator, chunk);
+	}
+	pool->free = NULL;
+	pool->chunks = NULL;
+	pool->cur = NULL;
+	pool->end = NULL;
+	pool->nobjs = MIN_CHUNK_OBJS;
+	return;
+}
+
+void ccl_pool_free(ccl_pool *pool)
+{
+	ccl_pool_clear(pool);
+	ccl_mem_free(pool->allocator, pool);
+	return;
+}
+
+static bool ccl_pool_grow(ccl_pool *pool)
+{
+	ccl_pool_chunk *chunk;
+
+	chunk = ccl_mem_alloc(pool->allocator, CHUNK_HDR_SIZE + pool->nobjs * pool->size);
+	if (chunk == NULL)
+		return false;
+	chunk->next = pool->chunks;
+	pool->chunks = chunk;
+	pool->cur = (char *)chunk + CHUNK_HDR_SIZE;
+	pool->end = pool->cur + pool->nobjs * pool->size;
+	if (pool->nobjs < MAX_CHUNK_OBJS)
+		pool->nobjs *= 2;
+	return true;
+}
+
+void *ccl_pool_alloc(ccl_pool *pool)
+{
+	void *p;
+
+	if (pool->free != NULL) {
+		p = pool->free;
+		pool->free = *(void **)p;
+		return p;
+	}
+	if (pool->cur == pool->end && !ccl_pool_grow(pool))
+		return NULL;
+	p = pool->cur;
+	pool->cur += pool->size;
+	return p;
+}
+
+void ccl_pool_dealloc(ccl_pool *pool, void *p)
+{
+	*(void **)p = pool->free;
+	pool->free = p;
+	return;
+}
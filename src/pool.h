@@ -0,0 +1,43 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifndef _CCL_POOL_H
+#define _CCL_POOL_H
+
+#include <classic/pool.h>
+
+#include "allocator.h"
+
+/* node allocation for containers created with or without CCL_POOL */
+static inline void *ccl_pool_get(ccl_pool *pool, const ccl_allocator *a, size_t size)
+{
+	return (pool != NULL ? ccl_pool_alloc(pool) : ccl_mem_alloc(a, size));
+}
+
+static inline void ccl_pool_put(ccl_pool *pool, const ccl_allocator *a, void *p)
+{
+	if (pool != NULL)
+		ccl_pool_dealloc(pool, p);
+	else
+		ccl_mem_free(a, p);
+	return;
+}
+
+#endif
@@ -23,11 +23,14 @@
 
 #include <classic/rb_tree.h>
 
-static ccl_rbnode *ccl_rbnode_alloc(void *k, void *v, bool black)
+#include "mapiter.h"
+#include "pool.h"
+
+static ccl_rbnode *ccl_rbnode_alloc(ccl_rbtree *tree, void *k, void *v, bool black)
 {
 	ccl_rbnode *node;
 
-	node = malloc(sizeof(*node));
+	node = ccl_pool_get(tree->pool, tree->allocator, sizeof(*node));
 	if (node == NULL)
 		return NULL;
 	node->key = k;
@@ -39,28 +42,44 @@ static ccl_rbnode *ccl_rbnode_alloc(void *k, void *v, bool black)
 	return node;
 }
 
-static void ccl_rbnode_dealloc(ccl_rbnode *node, void **k, void **v)
+static void ccl_rbnode_dealloc(ccl_rbtree *tree, ccl_rbnode *node, void **k, void **v)
 {
 	*k = node->key;
 	*v = node->value;
-	free(node);
+	ccl_pool_put(tree->pool, tree->allocator, node);
 	return;
 }
 
-ccl_rbtree *ccl_rbtree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+ccl_rbtree *ccl_rbtree_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_rbtree *tree;
 
 	if (cmp_cb == NULL)
 		return NULL;
-	tree = malloc(sizeof(*tree));
+	tree = ccl_mem_alloc(allocator, sizeof(*tree));
 	if (tree == NULL)
 		return NULL;
+	tree->root = NULL;
 	tree->cmp = cmp_cb;
 	tree->kfree = kfree_cb;
 	tree->vfree = vfree_cb;
 	tree->count = 0;
+	tree->allocator = allocator;
+	tree->pool = NULL;
+	if (flags & CCL_POOL) {
+		tree->pool = ccl_pool_new_ex(sizeof(ccl_rbnode), allocator);
+		if (tree->pool == NULL)
+			goto err;
+	}
 	return tree;
+err:
+	ccl_mem_free(allocator, tree);
+	return NULL;
+}
+
+ccl_rbtree *ccl_rbtree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+{
+	return ccl_rbtree_new_ex(cmp_cb, kfree_cb, vfree_cb, 0, NULL);
 }
 
 size_t ccl_rbtree_clear(ccl_rbtree *tree)
@@ -69,6 +88,15 @@ size_t ccl_rbtree_clear(ccl_rbtree *tree)
 	void *k, *v;
 	size_t count;
 
+	if (tree->pool != NULL && tree->kfree == NULL && tree->vfree == NULL) {
+		// nothing to release per node, drop the chunks at once
+		count = tree->count;
+		ccl_pool_clear(tree->pool);
+		tree->root = NULL;
+		tree->count = 0;
+		return count;
+	}
+
 	node = tree->root;
 	count = 0;
 	while (node) {
@@ -83,7 +111,7 @@ size_t ccl_rbtree_clear(ccl_rbtree *tree)
 		}
 
 		p = node->parent;
-		ccl_rbnode_dealloc(node, &k, &v);
+		ccl_rbnode_dealloc(tree, node, &k, &v);
 		if (tree->kfree != NULL)
 			tree->kfree(k);
 		if (tree->vfree != NULL)
@@ -106,7 +134,9 @@ size_t ccl_rbtree_clear(ccl_rbtree *tree)
 void ccl_rbtree_free(ccl_rbtree *tree)
 {
 	ccl_rbtree_clear(tree);
-	free(tree);
+	if (tree->pool != NULL)
+		ccl_pool_free(tree->pool);
+	ccl_mem_free(tree->allocator, tree);
 	return;
 }
 
@@ -327,7 +357,7 @@ bool ccl_rbtree_insert(ccl_rbtree *tree, void *k, void *v, void **pv)
 
 	// empty tree
 	if (tree->root == NULL) {
-		node = ccl_rbnode_alloc(k, v, true);
+		node = ccl_rbnode_alloc(tree, k, v, true);
 		if (node == NULL) {
 			return false;
 		} else {
@@ -353,7 +383,7 @@ bool ccl_rbtree_insert(ccl_rbtree *tree, void *k, void *v, void **pv)
 		}
 	}
 
-	node = ccl_rbnode_alloc(k, v, false);
+	node = ccl_rbnode_alloc(tree, k, v, false);
 	if (node == NULL)
 		return false;
 	node->parent = p;
@@ -504,7 +534,7 @@ bool ccl_rbtree_unlink(ccl_rbtree *tree, void *key, void **k, void **v)
 
 	if (rnode->black && tree->root != NULL)
 		ccl_rbtree_unlink_ftree(tree, cnode, p, dir);
-	ccl_rbnode_dealloc(rnode, k, v);
+	ccl_rbnode_dealloc(tree, rnode, k, v);
 	tree->count--;
 	return true;
 }
@@ -538,29 +568,248 @@ bool ccl_rbtree_foreach(ccl_rbtree *tree, ccl_dforeach_cb cb, void *user)
 	return true;
 }
 
+/* nodes for sorted keys, linked through ->right; all or nothing */
+static ccl_rbnode *ccl_rbtree_build_list(ccl_rbtree *tree, void **keys, void **values, size_t n)
+{
+	ccl_rbnode *head, **pnode, *node;
+	void *k, *v;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (keys[i] == NULL || (i > 0 && tree->cmp(keys[i - 1], keys[i]) >= 0))
+			return NULL;
+	}
+	head = NULL;
+	pnode = &head;
+	for (i = 0; i < n; i++) {
+		node = ccl_rbnode_alloc(tree, keys[i], values ? values[i] : NULL, true);
+		if (node == NULL)
+			goto err;
+		*pnode = node;
+		pnode = &node->right;
+	}
+	return head;
+err:
+	while (head != NULL) {
+		node = head->right;
+		ccl_rbnode_dealloc(tree, head, &k, &v);
+		head = node;
+	}
+	return NULL;
+}
+
+/* in-order build from the node list, left subtree gets the larger half */
+static ccl_rbnode *ccl_rbtree_build_subtree(ccl_rbnode **list, size_t n, unsigned depth, unsigned red_depth)
+{
+	ccl_rbnode *node, *left;
+
+	if (n == 0)
+		return NULL;
+	left = ccl_rbtree_build_subtree(list, n / 2, depth + 1, red_depth);
+	node = *list;
+	*list = node->right;
+	node->left = left;
+	if (left != NULL)
+		left->parent = node;
+	node->right = ccl_rbtree_build_subtree(list, n - n / 2 - 1, depth + 1, red_depth);
+	if (node->right != NULL)
+		node->right->parent = node;
+	node->black = (depth != red_depth);
+	return node;
+}
+
+bool ccl_rbtree_build_sorted(ccl_rbtree *tree, void **keys, void **values, size_t n)
+{
+	ccl_rbnode *list;
+	unsigned full;
+
+	if (tree->root != NULL)
+		return false;
+	if (n == 0)
+		return true;
+	list = ccl_rbtree_build_list(tree, keys, values, n);
+	if (list == NULL)
+		return false;
+	// depths 0 .. full - 1 are complete, a partial level at depth full goes red
+	for (full = 1; ((size_t)2 << full) - 1 <= n; full++)
+		;
+	tree->root = ccl_rbtree_build_subtree(&list, n, 0, (((size_t)1 << full) - 1 == n ? ~0U : full));
+	tree->root->parent = NULL;
+	tree->count = n;
+	return true;
+}
+
+/* first node with key >= k, or > k when strict */
+static ccl_rbnode *ccl_rbtree_bound_node(ccl_rbtree *tree, const void *k, bool strict)
+{
+	ccl_rbnode *node, *bound;
+	int ret;
+
+	bound = NULL;
+	node = tree->root;
+	while (node) {
+		ret = tree->cmp(k, node->key);
+		if (ret == 0 && !strict) {
+			bound = node;
+			break;
+		}
+		if (ret < 0) {
+			bound = node;
+			node = node->left;
+		} else {
+			node = node->right;
+		}
+	}
+	return bound;
+}
+
+bool ccl_rbtree_lower_bound(ccl_rbtree *tree, const void *k, void **key, void **value)
+{
+	ccl_rbnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_rbtree_bound_node(tree, k, false);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+bool ccl_rbtree_upper_bound(ccl_rbtree *tree, const void *k, void **key, void **value)
+{
+	ccl_rbnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_rbtree_bound_node(tree, k, true);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+/* entries with lo <= key < hi in order, a NULL bound is open */
+bool ccl_rbtree_range_foreach(ccl_rbtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	ccl_rbnode *node;
+
+	if (lo != NULL) {
+		node = ccl_rbtree_bound_node(tree, lo, false);
+	} else {
+		node = tree->root;
+		while (node && node->left)
+			node = node->left;
+	}
+	for (; node != NULL; node = ccl_rbnode_next(node)) {
+		if (hi != NULL && tree->cmp(node->key, hi) >= 0)
+			break;
+		if (!cb(node->key, node->value, user))
+			return false;
+	}
+	return true;
+}
+
+void ccl_rbtree_iter_init(ccl_rbtree_iter *it, ccl_rbtree *tree)
+{
+	it->node = NULL;
+	it->tree = tree;
+	return;
+}
+
+bool ccl_rbtree_iter_begin(ccl_rbtree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->left)
+		it->node = it->node->left;
+	return (it->node != NULL);
+}
+
+bool ccl_rbtree_iter_end(ccl_rbtree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->right)
+		it->node = it->node->right;
+	return (it->node != NULL);
+}
+
+/* position on the first entry with key >= k */
+bool ccl_rbtree_iter_seek(ccl_rbtree_iter *it, const void *k)
+{
+	it->node = (k != NULL ? ccl_rbtree_bound_node(it->tree, k, false) : NULL);
+	return (it->node != NULL);
+}
+
+bool ccl_rbtree_iter_next(ccl_rbtree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_rbnode_next(it->node);
+	return (it->node != NULL);
+}
+
+bool ccl_rbtree_iter_prev(ccl_rbtree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_rbnode_prev(it->node);
+	return (it->node != NULL);
+}
+
+void *ccl_rbtree_iter_key(ccl_rbtree_iter *it)
+{
+	return it->node->key;
+}
+
+void *ccl_rbtree_iter_value(ccl_rbtree_iter *it)
+{
+	return it->node->value;
+}
+
+CCL_MAP_ITER_OPS(ccl_rbtree, ccl_rbtree_iter)
+
 static struct ccl_map_ops map_ops = {
-	(ccl_map_free_cb)ccl_rbtree_free,
-	(ccl_map_clear_cb)ccl_rbtree_clear,
-	(ccl_map_select_cb)ccl_rbtree_select,
-	(ccl_map_insert_cb)ccl_rbtree_insert,
-	(ccl_map_delete_cb)ccl_rbtree_delete,
-	(ccl_map_foreach_cb)ccl_rbtree_foreach,
+	.free		= (ccl_map_free_cb)ccl_rbtree_free,
+	.clear		= (ccl_map_clear_cb)ccl_rbtree_clear,
+	.select		= (ccl_map_select_cb)ccl_rbtree_select,
+	.insert		= (ccl_map_insert_cb)ccl_rbtree_insert,
+	.delete		= (ccl_map_delete_cb)ccl_rbtree_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_rbtree_foreach,
+	.build_sorted	= (ccl_map_build_cb)ccl_rbtree_build_sorted,
+	.lower_bound	= (ccl_map_bound_cb)ccl_rbtree_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_rbtree_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_rbtree_range_foreach,
+	.iter_begin	= ccl_rbtree_map_iter_begin,
+	.iter_end	= ccl_rbtree_map_iter_end,
+	.iter_seek	= ccl_rbtree_map_iter_seek,
+	.iter_next	= ccl_rbtree_map_iter_next,
+	.iter_prev	= ccl_rbtree_map_iter_prev,
+	.iter_key	= ccl_rbtree_map_iter_key,
+	.iter_value	= ccl_rbtree_map_iter_value,
 };
 
-ccl_map *ccl_smap_rbtree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+ccl_map *ccl_smap_rbtree_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_map *map;
 
-	map = malloc(sizeof(*map));
+	map = ccl_mem_alloc(allocator, sizeof(*map));
 	if (map == NULL)
 		return NULL;
-	map->obj = ccl_rbtree_new(cmp_cb, kfree_cb, vfree_cb);
+	map->obj = ccl_rbtree_new_ex(cmp_cb, kfree_cb, vfree_cb, flags, allocator);
 	if (map->obj == NULL)
 		goto err;
 	map->ops = &map_ops;
+	map->allocator = allocator;
 	map->sorted = true;
 	return map;
 err:
-	free(map);
+	ccl_mem_free(allocator, map);
 	return NULL;
 }
+
+ccl_map *ccl_smap_rbtree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+{
+	return ccl_smap_rbtree_ex(cmp_cb, kfree_cb, vfree_cb, 0, NULL);
+}
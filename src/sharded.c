@@ -0,0 +1,384 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: hash partitioned map, one lock per shard, k-way merge of sorted
+         shards through a binary heap
+   Ref:  [Herlihy 2008], [Knuth 1998].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <classic/map.h>
+
+#include "hashtable.h"
+#include "allocator.h"
+#include "lock.h"
+
+/*
+ * The shard of a key comes from the top bits of its mixed hash, so that
+ * shard hash tables fed by the same hash callback still use all of their
+ * buckets.  Single key operations take one shard lock and hand the hash
+ * on to the shard's hashed entry point, so a key is hashed once.  A bound
+ * query walks the shards in index order holding at most the lock of the
+ * best candidate so far and the one being looked at; ordered scans take
+ * every lock, also in index order, so the two never deadlock.
+ */
+#define SHARD_PAD			64
+
+struct ccl_shard_t {
+	ccl_lock lock;
+	ccl_map *map;
+	char pad[SHARD_PAD];		// keep the next lock off this cache line
+};
+
+typedef struct ccl_sharded_t {
+	struct ccl_shard_t *shards;
+	unsigned count;
+	ccl_hash_cb hash;
+	ccl_cmp_cb cmp;			// NULL unless the shards are merged in order
+	const ccl_allocator *allocator;
+} ccl_sharded;
+
+// position of an ordered scan in one shard
+struct ccl_shard_cursor {
+	void *key;
+	void *value;
+};
+
+static inline struct ccl_shard_t *ccl_sharded_shard(ccl_sharded *sm, uint64_t hash)
+{
+	return &sm->shards[((ccl_ht_mix64(hash) >> 32) * sm->count) >> 32];
+}
+
+static void ccl_sharded_free(ccl_sharded *sm)
+{
+	unsigned i;
+
+	for (i = 0; i < sm->count; i++) {
+		ccl_map_free(sm->shards[i].map);
+		ccl_lock_destroy(&sm->shards[i].lock);
+	}
+	ccl_mem_free(sm->allocator, sm->shards);
+	ccl_mem_free(sm->allocator, sm);
+	return;
+}
+
+static size_t ccl_sharded_clear(ccl_sharded *sm)
+{
+	struct ccl_shard_t *s;
+	size_t count;
+	unsigned i;
+
+	for (i = 0, count = 0; i < sm->count; i++) {
+		s = &sm->shards[i];
+		ccl_lock_acquire(&s->lock);
+		count += ccl_map_clear(s->map);
+		ccl_lock_release(&s->lock);
+	}
+	return count;
+}
+
+static bool ccl_sharded_select_hashed(ccl_sharded *sm, const void *k, uint64_t hash, void **v)
+{
+	struct ccl_shard_t *s;
+	bool ret;
+
+	if (k == NULL)
+		return false;
+	s = ccl_sharded_shard(sm, hash);
+	ccl_lock_acquire(&s->lock);
+	ret = ccl_map_select_hashed(s->map, k, hash, v);
+	ccl_lock_release(&s->lock);
+	return ret;
+}
+
+static bool ccl_sharded_insert_hashed(ccl_sharded *sm, const void *k, void *v, uint64_t hash, void **pv)
+{
+	struct ccl_shard_t *s;
+	bool ret;
+
+	if (k == NULL)
+		return false;
+	s = ccl_sharded_shard(sm, hash);
+	ccl_lock_acquire(&s->lock);
+	ret = ccl_map_insert_hashed(s->map, k, v, hash, pv);
+	ccl_lock_release(&s->lock);
+	return ret;
+}
+
+static bool ccl_sharded_delete_hashed(ccl_sharded *sm, const void *k, uint64_t hash)
+{
+	struct ccl_shard_t *s;
+	bool ret;
+
+	if (k == NULL)
+		return false;
+	s = ccl_sharded_shard(sm, hash);
+	ccl_lock_acquire(&s->lock);
+	ret = ccl_map_delete_hashed(s->map, k, hash);
+	ccl_lock_release(&s->lock);
+	return ret;
+}
+
+static bool ccl_sharded_select(ccl_sharded *sm, const void *k, void **v)
+{
+	if (k == NULL)
+		return false;
+	return ccl_sharded_select_hashed(sm, k, sm->hash(k), v);
+}
+
+static bool ccl_sharded_insert(ccl_sharded *sm, const void *k, void *v, void **pv)
+{
+	if (k == NULL)
+		return false;
+	return ccl_sharded_insert_hashed(sm, k, v, sm->hash(k), pv);
+}
+
+static bool ccl_sharded_delete(ccl_sharded *sm, const void *k)
+{
+	if (k == NULL)
+		return false;
+	return ccl_sharded_delete_hashed(sm, k, sm->hash(k));
+}
+
+static bool ccl_sharded_foreach(ccl_sharded *sm, ccl_dforeach_cb cb, void *user)
+{
+	struct ccl_shard_t *s;
+	unsigned i;
+	bool ret;
+
+	for (i = 0, ret = true; i < sm->count && ret; i++) {
+		s = &sm->shards[i];
+		ccl_lock_acquire(&s->lock);
+		ret = ccl_map_foreach(s->map, cb, user);
+		ccl_lock_release(&s->lock);
+	}
+	return ret;
+}
+
+static bool ccl_sharded_bound(ccl_sharded *sm, const void *k, void **key, void **value, bool upper)
+{
+	struct ccl_shard_t *s, *best;
+	void *bkey, *bvalue, *ckey, *cvalue;
+	unsigned i;
+	bool found;
+
+	best = NULL;
+	bkey = bvalue = NULL;
+	for (i = 0; i < sm->count; i++) {
+		s = &sm->shards[i];
+		ccl_lock_acquire(&s->lock);
+		if (upper)
+			found = ccl_map_upper_bound(s->map, k, &ckey, &cvalue);
+		else
+			found = ccl_map_lower_bound(s->map, k, &ckey, &cvalue);
+		if (found && (best == NULL || sm->cmp(ckey, bkey) < 0)) {
+			// the old candidate lost, its key may now go away
+			if (best != NULL)
+				ccl_lock_release(&best->lock);
+			best = s;
+			bkey = ckey;
+			bvalue = cvalue;
+		} else {
+			ccl_lock_release(&s->lock);
+		}
+	}
+	if (best == NULL)
+		return false;
+	ccl_lock_release(&best->lock);
+	*key = bkey;
+	*value = bvalue;
+	return true;
+}
+
+static bool ccl_sharded_lower_bound(ccl_sharded *sm, const void *k, void **key, void **value)
+{
+	return ccl_sharded_bound(sm, k, key, value, false);
+}
+
+static bool ccl_sharded_upper_bound(ccl_sharded *sm, const void *k, void **key, void **value)
+{
+	return ccl_sharded_bound(sm, k, key, value, true);
+}
+
+static bool ccl_sharded_first(const void *k, void *v, void *user)
+{
+	struct ccl_shard_cursor *cur = user;
+
+	cur->key = (void *)k;
+	cur->value = v;
+	return false;
+}
+
+// restore the heap order below heap[i], smallest key on top
+static void ccl_sharded_sift(ccl_sharded *sm, struct ccl_shard_cursor *cur, unsigned *heap, unsigned n, unsigned i)
+{
+	unsigned c, top;
+
+	top = heap[i];
+	while ((c = 2 * i + 1) < n) {
+		if (c + 1 < n && sm->cmp(cur[heap[c + 1]].key, cur[heap[c]].key) < 0)
+			c++;
+		if (sm->cmp(cur[heap[c]].key, cur[top].key) >= 0)
+			break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = top;
+	return;
+}
+
+/*
+ * Ordered scan of lo <= key < hi over all shards.  Each shard has a cursor
+ * on its next key, found by range_foreach for the first one and by
+ * upper_bound after that, so any sorted backend will do; a heap of the
+ * cursors yields the keys in order.  Keys are unique across shards.
+ */
+static bool ccl_sharded_range_foreach(ccl_sharded *sm, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	struct ccl_shard_cursor *cur;
+	struct ccl_shard_t *s;
+	unsigned *heap;
+	unsigned i, n;
+	bool ret;
+
+	cur = ccl_mem_alloc(sm->allocator, sm->count * (sizeof(*cur) + sizeof(*heap)));
+	if (cur == NULL)
+		return false;
+	heap = (unsigned *)(cur + sm->count);
+	for (i = 0; i < sm->count; i++)
+		ccl_lock_acquire(&sm->shards[i].lock);
+	for (i = 0, n = 0; i < sm->count; i++) {
+		cur[i].key = NULL;
+		ccl_map_range_foreach(sm->shards[i].map, lo, hi, ccl_sharded_first, &cur[i]);
+		if (cur[i].key != NULL)
+			heap[n++] = i;
+	}
+	for (i = n / 2; i-- > 0; )
+		ccl_sharded_sift(sm, cur, heap, n, i);
+	ret = true;
+	while (n > 0) {
+		i = heap[0];
+		if (!(ret = cb(cur[i].key, cur[i].value, user)))
+			break;
+		s = &sm->shards[i];
+		if (!ccl_map_upper_bound(s->map, cur[i].key, &cur[i].key, &cur[i].value)
+		    || (hi != NULL && sm->cmp(cur[i].key, hi) >= 0))
+			heap[0] = heap[--n];	// shard i is done
+		ccl_sharded_sift(sm, cur, heap, n, 0);
+	}
+	for (i = 0; i < sm->count; i++)
+		ccl_lock_release(&sm->shards[i].lock);
+	ccl_mem_free(sm->allocator, cur);
+	return ret;
+}
+
+static bool ccl_sharded_merge_foreach(ccl_sharded *sm, ccl_dforeach_cb cb, void *user)
+{
+	return ccl_sharded_range_foreach(sm, NULL, NULL, cb, user);
+}
+
+static struct ccl_map_ops map_ops = {
+	.free		= (ccl_map_free_cb)ccl_sharded_free,
+	.clear		= (ccl_map_clear_cb)ccl_sharded_clear,
+	.select		= (ccl_map_select_cb)ccl_sharded_select,
+	.insert		= (ccl_map_insert_cb)ccl_sharded_insert,
+	.delete		= (ccl_map_delete_cb)ccl_sharded_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_sharded_foreach,
+	.select_hashed	= (ccl_map_select_hashed_cb)ccl_sharded_select_hashed,
+	.insert_hashed	= (ccl_map_insert_hashed_cb)ccl_sharded_insert_hashed,
+	.delete_hashed	= (ccl_map_delete_hashed_cb)ccl_sharded_delete_hashed,
+};
+
+static struct ccl_map_ops sorted_map_ops = {
+	.free		= (ccl_map_free_cb)ccl_sharded_free,
+	.clear		= (ccl_map_clear_cb)ccl_sharded_clear,
+	.select		= (ccl_map_select_cb)ccl_sharded_select,
+	.insert		= (ccl_map_insert_cb)ccl_sharded_insert,
+	.delete		= (ccl_map_delete_cb)ccl_sharded_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_sharded_merge_foreach,
+	.lower_bound	= (ccl_map_bound_cb)ccl_sharded_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_sharded_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_sharded_range_foreach,
+	.select_hashed	= (ccl_map_select_hashed_cb)ccl_sharded_select_hashed,
+	.insert_hashed	= (ccl_map_insert_hashed_cb)ccl_sharded_insert_hashed,
+	.delete_hashed	= (ccl_map_delete_hashed_cb)ccl_sharded_delete_hashed,
+};
+
+ccl_map *ccl_map_sharded(unsigned n, ccl_map_factory_cb factory, void *user, ccl_hash_cb hash_cb, ccl_cmp_cb cmp_cb)
+{
+	const ccl_allocator *allocator;
+	struct ccl_shard_t *s;
+	ccl_sharded *sm;
+	ccl_map *map, *first;
+	unsigned i;
+
+	if (n == 0 || hash_cb == NULL)
+		return NULL;
+	first = factory(user);
+	if (first == NULL)
+		return NULL;
+	allocator = first->allocator;
+	sm = ccl_mem_alloc(allocator, sizeof(*sm));
+	if (sm == NULL)
+		goto err_sm;
+	sm->shards = ccl_mem_calloc(allocator, n, sizeof(*sm->shards));
+	if (sm->shards == NULL)
+		goto err_shards;
+	map = ccl_mem_alloc(allocator, sizeof(*map));
+	if (map == NULL)
+		goto err_map;
+	for (i = 0; i < n; i++) {
+		s = &sm->shards[i];
+		s->map = (i == 0 ? first : factory(user));
+		if (s->map == NULL)
+			goto err;
+		if (!ccl_lock_init(&s->lock)) {
+			if (i > 0)
+				ccl_map_free(s->map);
+			goto err;
+		}
+	}
+	sm->count = n;
+	sm->hash = hash_cb;
+	sm->cmp = (first->sorted ? cmp_cb : NULL);
+	sm->allocator = allocator;
+	map->obj = sm;
+	map->ops = (sm->cmp != NULL ? &sorted_map_ops : &map_ops);
+	map->allocator = allocator;
+	map->sorted = (sm->cmp != NULL);
+	return map;
+err:
+	while (i-- > 0) {
+		s = &sm->shards[i];
+		if (i > 0)
+			ccl_map_free(s->map);
+		ccl_lock_destroy(&s->lock);
+	}
+	ccl_mem_free(allocator, map);
+err_map:
+	ccl_mem_free(allocator, sm->shards);
+err_shards:
+	ccl_mem_free(allocator, sm);
+err_sm:
+	ccl_map_free(first);
+	return NULL;
+}
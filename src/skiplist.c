@@ -26,11 +26,26 @@
 
 #include <classic/skiplist.h>
 
-static ccl_skipnode *ccl_skipnode_alloc(void *k, unsigned link_count)
+#include "mapiter.h"
+#include "pool.h"
+
+static ccl_skipnode *ccl_skipnode_alloc(ccl_skiplist *list, void *k, unsigned link_count)
 {
 	ccl_skipnode *node;
-
-	node = malloc(sizeof(*node) + sizeof(node->link[0]) * link_count);
+	ccl_pool *pool;
+	size_t size;
+
+	size = sizeof(*node) + sizeof(node->link[0]) * link_count;
+	pool = NULL;
+	if (list->pools != NULL) {
+		// nodes differ in size by height, so there is one pool per height
+		if (list->pools[link_count] == NULL)
+			list->pools[link_count] = ccl_pool_new_ex(size, list->allocator);
+		pool = list->pools[link_count];
+		if (pool == NULL)
+			return NULL;
+	}
+	node = ccl_pool_get(pool, list->allocator, size);
 	if (node == NULL)
 		return NULL;
 	node->key = k;
@@ -41,15 +56,15 @@ static ccl_skipnode *ccl_skipnode_alloc(void *k, unsigned link_count)
 	return node;
 }
 
-static void ccl_skipnode_dealloc(ccl_skipnode *node, void **k, void **v)
+static void ccl_skipnode_dealloc(ccl_skiplist *list, ccl_skipnode *node, void **k, void **v)
 {
 	*k = node->key;
 	*v = node->value;
-	free(node);
+	ccl_pool_put(list->pools ? list->pools[node->link_count] : NULL, list->allocator, node);
 	return;
 }
 
-ccl_skiplist *ccl_skiplist_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_maxlink_cb maxlink_cb, unsigned max_link)
+ccl_skiplist *ccl_skiplist_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_maxlink_cb maxlink_cb, unsigned max_link, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_skiplist *list;
 
@@ -57,12 +72,19 @@ ccl_skiplist *ccl_skiplist_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free
 		return NULL;
 	if (max_link > MAX_LINK)
 		max_link = MAX_LINK;
-	list = malloc(sizeof(*list));
+	list = ccl_mem_alloc(allocator, sizeof(*list));
 	if (list == NULL)
 		return NULL;
-	list->head = ccl_skipnode_alloc(NULL, max_link);
+	list->allocator = allocator;
+	list->pools = NULL;		// the head node is never pooled
+	list->head = ccl_skipnode_alloc(list, NULL, max_link);
 	if (list->head == NULL)
 		goto err;
+	if (flags & CCL_POOL) {
+		list->pools = ccl_mem_calloc(allocator, MAX_LINK + 1, sizeof(list->pools[0]));
+		if (list->pools == NULL)
+			goto err_head;
+	}
 	list->max_link = max_link;
 	list->top_link = 0;
 	list->cmp = cmp_cb;
@@ -71,21 +93,37 @@ ccl_skiplist *ccl_skiplist_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free
 	list->maxlink = maxlink_cb;
 	list->count = 0;
 	return list;
+err_head:
+	ccl_mem_free(allocator, list->head);
 err:
-	free(list);
+	ccl_mem_free(allocator, list);
 	return NULL;
 }
 
+ccl_skiplist *ccl_skiplist_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_maxlink_cb maxlink_cb, unsigned max_link)
+{
+	return ccl_skiplist_new_ex(cmp_cb, kfree_cb, vfree_cb, maxlink_cb, max_link, 0, NULL);
+}
+
 size_t ccl_skiplist_clear(ccl_skiplist *list)
 {
 	ccl_skipnode *node, *next;
 	void *k, *v;
 	size_t count;
+	unsigned i;
 
 	node = list->head->link[0];
+	if (list->pools != NULL && list->kfree == NULL && list->vfree == NULL) {
+		// nothing to release per node, drop the chunks at once
+		for (i = 0; i <= MAX_LINK; i++) {
+			if (list->pools[i] != NULL)
+				ccl_pool_clear(list->pools[i]);
+		}
+		node = NULL;
+	}
 	while (node) {
 		next = node->link[0];
-		ccl_skipnode_dealloc(node, &k, &v);
+		ccl_skipnode_dealloc(list, node, &k, &v);
 		if (list->kfree != NULL)
 			list->kfree(k);
 		if (list->vfree != NULL)
@@ -94,19 +132,27 @@ size_t ccl_skiplist_clear(ccl_skiplist *list)
 	}
 
 	list->head->link[list->top_link] = NULL;
-	count = 0;
-	while (list->top_link) {
+	while (list->top_link)
 		list->head->link[--list->top_link] = NULL;
-		count++;
-	}
+	count = list->count;
+	list->count = 0;
 	return count;
 }
 
 void ccl_skiplist_free(ccl_skiplist *list)
 {
+	unsigned i;
+
 	ccl_skiplist_clear(list);
-	free(list->head);
-	free(list);
+	if (list->pools != NULL) {
+		for (i = 0; i <= MAX_LINK; i++) {
+			if (list->pools[i] != NULL)
+				ccl_pool_free(list->pools[i]);
+		}
+		ccl_mem_free(list->allocator, list->pools);
+	}
+	ccl_mem_free(list->allocator, list->head);
+	ccl_mem_free(list->allocator, list);
 	return;
 }
 
@@ -180,9 +226,10 @@ bool ccl_skiplist_insert(ccl_skiplist *list, void *k, void *v, void **pv)
 		update[i] = node1;
 	}
 
-	node = ccl_skipnode_alloc(k, list->maxlink(list));
+	node = ccl_skipnode_alloc(list, k, list->maxlink(list));
 	if (node == NULL)
 		return false;
+	node->value = v;
 
 	nlinks = node->link_count;
 	if (list->top_link < nlinks) {
@@ -257,7 +304,7 @@ bool ccl_skiplist_unlink(ccl_skiplist *list, void *key, void **k, void **v)
 		node->link[0]->prev = node->prev;
 	while (list->top_link > 0 && !list->head->link[list->top_link - 1])
 		list->top_link--;
-	ccl_skipnode_dealloc(node, k, v);
+	ccl_skipnode_dealloc(list, node, k, v);
 	list->count--;
 	return true;
 }
@@ -286,29 +333,226 @@ bool ccl_skiplist_foreach(ccl_skiplist *list, ccl_dforeach_cb cb, void *user)
 	return true;
 }
 
+bool ccl_skiplist_build_sorted(ccl_skiplist *list, void **keys, void **values, size_t n)
+{
+	ccl_skipnode *node, *first, *last[MAX_LINK], **pnode;
+	void *k, *v;
+	unsigned i, nlinks;
+	size_t j;
+
+	if (list->count != 0)
+		return false;
+	for (j = 0; j < n; j++) {
+		if (keys[j] == NULL || (j > 0 && list->cmp(keys[j - 1], keys[j]) >= 0))
+			return false;
+	}
+
+	// allocate everything first, chained through link[0], so failure is clean
+	first = NULL;
+	pnode = &first;
+	for (j = 0; j < n; j++) {
+		nlinks = list->maxlink(list);
+		node = ccl_skipnode_alloc(list, keys[j], (nlinks ? nlinks : 1));
+		if (node == NULL)
+			goto err;
+		node->value = (values ? values[j] : NULL);
+		*pnode = node;
+		pnode = &node->link[0];
+	}
+
+	for (i = 0; i < MAX_LINK; i++)
+		last[i] = list->head;
+	for (node = first; node != NULL; node = node->link[0]) {
+		node->prev = (last[0] == list->head ? NULL : last[0]);
+		for (i = 1; i < node->link_count; i++) {
+			last[i]->link[i] = node;
+			last[i] = node;
+		}
+		last[0] = node;
+		if (list->top_link < node->link_count)
+			list->top_link = node->link_count;
+	}
+	list->head->link[0] = first;
+	list->count = n;
+	return true;
+err:
+	while (first != NULL) {
+		node = first->link[0];
+		ccl_skipnode_dealloc(list, first, &k, &v);
+		first = node;
+	}
+	return false;
+}
+
+/* first node with key >= k, or > k when strict */
+static ccl_skipnode *ccl_skiplist_bound_node(ccl_skiplist *list, const void *k, bool strict)
+{
+	ccl_skipnode *node1, *node2;
+	unsigned i;
+	int ret;
+
+	node1 = list->head;
+	for (i = list->top_link + 1; i-- > 0; ) {
+		for (;;) {
+			node2 = node1->link[i];
+			if (node2 == NULL)
+				break;
+			ret = list->cmp(k, node2->key);
+			if (ret == 0 && !strict)
+				return node2;
+			if (ret < 0)
+				break;
+			node1 = node2;
+		}
+	}
+	return node1->link[0];
+}
+
+bool ccl_skiplist_lower_bound(ccl_skiplist *list, const void *k, void **key, void **value)
+{
+	ccl_skipnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_skiplist_bound_node(list, k, false);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+bool ccl_skiplist_upper_bound(ccl_skiplist *list, const void *k, void **key, void **value)
+{
+	ccl_skipnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_skiplist_bound_node(list, k, true);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+/* entries with lo <= key < hi in order, a NULL bound is open */
+bool ccl_skiplist_range_foreach(ccl_skiplist *list, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	ccl_skipnode *node;
+
+	node = (lo != NULL ? ccl_skiplist_bound_node(list, lo, false) : list->head->link[0]);
+	for (; node != NULL; node = node->link[0]) {
+		if (hi != NULL && list->cmp(node->key, hi) >= 0)
+			break;
+		if (!cb(node->key, node->value, user))
+			return false;
+	}
+	return true;
+}
+
+void ccl_skiplist_iter_init(ccl_skiplist_iter *it, ccl_skiplist *tree)
+{
+	it->node = NULL;
+	it->tree = tree;
+	return;
+}
+
+bool ccl_skiplist_iter_begin(ccl_skiplist_iter *it)
+{
+	it->node = it->tree->head->link[0];
+	return (it->node != NULL);
+}
+
+bool ccl_skiplist_iter_end(ccl_skiplist_iter *it)
+{
+	ccl_skipnode *node;
+	unsigned i;
+
+	node = it->tree->head;
+	for (i = it->tree->top_link + 1; i-- > 0; ) {
+		while (node->link[i] != NULL)
+			node = node->link[i];
+	}
+	it->node = (node == it->tree->head ? NULL : node);
+	return (it->node != NULL);
+}
+
+/* position on the first entry with key >= k */
+bool ccl_skiplist_iter_seek(ccl_skiplist_iter *it, const void *k)
+{
+	it->node = (k != NULL ? ccl_skiplist_bound_node(it->tree, k, false) : NULL);
+	return (it->node != NULL);
+}
+
+bool ccl_skiplist_iter_next(ccl_skiplist_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = it->node->link[0];
+	return (it->node != NULL);
+}
+
+bool ccl_skiplist_iter_prev(ccl_skiplist_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = it->node->prev;
+	return (it->node != NULL);
+}
+
+void *ccl_skiplist_iter_key(ccl_skiplist_iter *it)
+{
+	return it->node->key;
+}
+
+void *ccl_skiplist_iter_value(ccl_skiplist_iter *it)
+{
+	return it->node->value;
+}
+
+CCL_MAP_ITER_OPS(ccl_skiplist, ccl_skiplist_iter)
+
 static struct ccl_map_ops map_ops = {
-	(ccl_map_free_cb)ccl_skiplist_free,
-	(ccl_map_clear_cb)ccl_skiplist_clear,
-	(ccl_map_select_cb)ccl_skiplist_select,
-	(ccl_map_insert_cb)ccl_skiplist_insert,
-	(ccl_map_delete_cb)ccl_skiplist_delete,
-	(ccl_map_foreach_cb)ccl_skiplist_foreach,
+	.free		= (ccl_map_free_cb)ccl_skiplist_free,
+	.clear		= (ccl_map_clear_cb)ccl_skiplist_clear,
+	.select		= (ccl_map_select_cb)ccl_skiplist_select,
+	.insert		= (ccl_map_insert_cb)ccl_skiplist_insert,
+	.delete		= (ccl_map_delete_cb)ccl_skiplist_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_skiplist_foreach,
+	.build_sorted	= (ccl_map_build_cb)ccl_skiplist_build_sorted,
+	.lower_bound	= (ccl_map_bound_cb)ccl_skiplist_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_skiplist_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_skiplist_range_foreach,
+	.iter_begin	= ccl_skiplist_map_iter_begin,
+	.iter_end	= ccl_skiplist_map_iter_end,
+	.iter_seek	= ccl_skiplist_map_iter_seek,
+	.iter_next	= ccl_skiplist_map_iter_next,
+	.iter_prev	= ccl_skiplist_map_iter_prev,
+	.iter_key	= ccl_skiplist_map_iter_key,
+	.iter_value	= ccl_skiplist_map_iter_value,
 };
 
-ccl_map *ccl_smap_skiplist(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_maxlink_cb maxlink_cb, unsigned max_link)
+ccl_map *ccl_smap_skiplist_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_maxlink_cb maxlink_cb, unsigned max_link, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_map *map;
 
-	map = malloc(sizeof(*map));
+	map = ccl_mem_alloc(allocator, sizeof(*map));
 	if (map == NULL)
 		return NULL;
-	map->obj = ccl_skiplist_new(cmp_cb, kfree_cb, vfree_cb, maxlink_cb, max_link);
+	map->obj = ccl_skiplist_new_ex(cmp_cb, kfree_cb, vfree_cb, maxlink_cb, max_link, flags, allocator);
 	if (map->obj == NULL)
 		goto err;
 	map->ops = &map_ops;
+	map->allocator = allocator;
 	map->sorted = true;
 	return map;
 err:
-	free(map);
+	ccl_mem_free(allocator, map);
 	return NULL;
 }
+
+ccl_map *ccl_smap_skiplist(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_maxlink_cb maxlink_cb, unsigned max_link)
+{
+	return ccl_smap_skiplist_ex(cmp_cb, kfree_cb, vfree_cb, maxlink_cb, max_link, 0, NULL);
+}
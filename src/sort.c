@@ -0,0 +1,407 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: pattern-defeating quicksort.
+   Ref: [Peters 2021], [Musser 1997].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <stdint.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <classic/sort.h>
+
+#include "allocator.h"
+
+int ccl_cmp_uintptr(const void *a, const void *b)
+{
+	uintptr_t x = (uintptr_t)a, y = (uintptr_t)b;
+	return (x > y) - (x < y);
+}
+
+int ccl_cmp_intptr(const void *a, const void *b)
+{
+	intptr_t x = (intptr_t)a, y = (intptr_t)b;
+	return (x > y) - (x < y);
+}
+
+int ccl_cmp_str(const void *a, const void *b)
+{
+	return strcmp(a, b);
+}
+
+// generic engine, one indirect call per comparison
+#define CCL_SORT_NAME		ccl_sort_cb
+#define CCL_SORT_TYPE		void *
+#define CCL_SORT_CTX		ccl_cmp_cb
+#define CCL_SORT_LESS(cmp, a, b)	((cmp)((a), (b)) < 0)
+#include "sort.h"
+
+#define CCL_SORT_NAME		ccl_sort_ptr_uint
+#define CCL_SORT_TYPE		void *
+#define CCL_SORT_CTX		void *
+#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), (uintptr_t)(a) < (uintptr_t)(b))
+#include "sort.h"
+
+#define CCL_SORT_NAME		ccl_sort_ptr_int
+#define CCL_SORT_TYPE		void *
+#define CCL_SORT_CTX		void *
+#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), (intptr_t)(a) < (intptr_t)(b))
+#include "sort.h"
+
+#define CCL_SORT_NAME		ccl_sort_ptr_str
+#define CCL_SORT_TYPE		void *
+#define CCL_SORT_CTX		void *
+#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), strcmp((a), (b)) < 0)
+#include "sort.h"
+
+// radix sort fallback, one key call per comparison side
+#define CCL_SORT_NAME		ccl_sort_key
+#define CCL_SORT_TYPE		void *
+#define CCL_SORT_CTX		ccl_key64_cb
+#define CCL_SORT_LESS(key, a, b)	((key)(a) < (key)(b))
+#include "sort.h"
+
+#define CCL_SORT_NAME		ccl_sort_u64_impl
+#define CCL_SORT_TYPE		uint64_t
+#define CCL_SORT_CTX		void *
+#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), (a) < (b))
+#include "sort.h"
+
+#define CCL_SORT_NAME		ccl_sort_i64_impl
+#define CCL_SORT_TYPE		int64_t
+#define CCL_SORT_CTX		void *
+#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), (a) < (b))
+#include "sort.h"
+
+// total order with NaNs last, plain < is not a strict weak ordering
+#define CCL_SORT_NAME		ccl_sort_double_impl
+#define CCL_SORT_TYPE		double
+#define CCL_SORT_CTX		void *
+#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), (a) < (b) || ((a) == (a) && (b) != (b)))
+#include "sort.h"
+
+#define CCL_SORT_NAME		ccl_sort_str_impl
+#define CCL_SORT_TYPE		char *
+#define CCL_SORT_CTX		void *
+#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), strcmp((a), (b)) < 0)
+#include "sort.h"
+
+void ccl_sort(void **base, size_t n, ccl_cmp_cb cmp)
+{
+	if (cmp == ccl_cmp_uintptr)
+		ccl_sort_ptr_uint(base, n, NULL);
+	else if (cmp == ccl_cmp_intptr)
+		ccl_sort_ptr_int(base, n, NULL);
+	else if (cmp == ccl_cmp_str)
+		ccl_sort_ptr_str(base, n, NULL);
+	else
+		ccl_sort_cb(base, n, cmp);
+	return;
+}
+
+void ccl_sort_u64(uint64_t *base, size_t n)
+{
+	ccl_sort_u64_impl(base, n, NULL);
+	return;
+}
+
+void ccl_sort_i64(int64_t *base, size_t n)
+{
+	ccl_sort_i64_impl(base, n, NULL);
+	return;
+}
+
+void ccl_sort_double(double *base, size_t n)
+{
+	ccl_sort_double_impl(base, n, NULL);
+	return;
+}
+
+void ccl_sort_str(char **base, size_t n)
+{
+	ccl_sort_str_impl(base, n, NULL);
+	return;
+}
+
+#ifdef HAVE_PTHREAD_H
+#define PARALLEL_MIN_CHUNK	(1U << 16)	// fewer items per thread are sorted serially
+#define PARALLEL_MAX_THREADS	256
+
+/*
+ * One unit of parallel work: with dst == NULL sort a[0..na) in place,
+ * otherwise stable-merge a[0..na) and b[0..nb) into dst (a copy if nb == 0).
+ */
+struct ccl_sort_job {
+	void **a;
+	void **b;
+	void **dst;
+	size_t na;
+	size_t nb;
+	ccl_cmp_cb cmp;
+};
+
+static void *ccl_sort_job_run(void *arg)
+{
+	struct ccl_sort_job *job = arg;
+	void **a, **b, **ae, **be, **dst;
+
+	if (job->dst == NULL) {
+		ccl_sort(job->a, job->na, job->cmp);
+		return NULL;
+	}
+	a = job->a;
+	ae = a + job->na;
+	b = job->b;
+	be = b + job->nb;
+	dst = job->dst;
+	while (a < ae && b < be) {
+		if (job->cmp(*b, *a) < 0)
+			*dst++ = *b++;
+		else
+			*dst++ = *a++;
+	}
+	if (a < ae)
+		memcpy(dst, a, (size_t)(ae - a) * sizeof(void *));
+	else if (b < be)
+		memcpy(dst, b, (size_t)(be - b) * sizeof(void *));
+	return NULL;
+}
+
+static void ccl_sort_jobs(struct ccl_sort_job *jobs, unsigned njobs)
+{
+	pthread_t tid[PARALLEL_MAX_THREADS + 1];
+	bool started[PARALLEL_MAX_THREADS + 1];
+	unsigned i;
+
+	// job 0 runs on the calling thread, as does any job that fails to start
+	for (i = 1; i < njobs; i++) {
+		started[i] = (pthread_create(&tid[i], NULL, ccl_sort_job_run, &jobs[i]) == 0);
+		if (!started[i])
+			ccl_sort_job_run(&jobs[i]);
+	}
+	ccl_sort_job_run(&jobs[0]);
+	for (i = 1; i < njobs; i++) {
+		if (started[i])
+			pthread_join(tid[i], NULL);
+	}
+	return;
+}
+
+/*
+ * Number of items taken from a in the first d items of the stable merge of
+ * a and b (merge path split), so merges can be cut into independent parts.
+ */
+static size_t ccl_sort_corank(size_t d, void **a, size_t na, void **b, size_t nb, ccl_cmp_cb cmp)
+{
+	size_t lo, hi, mid;
+
+	lo = (d > nb ? d - nb : 0);
+	hi = (d < na ? d : na);
+	while (lo < hi) {
+		mid = lo + ((hi - lo) >> 1);
+		if (cmp(b[d - mid - 1], a[mid]) >= 0)
+			lo = mid + 1;		// a[mid] precedes b[d - mid - 1]
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// queue the merge of a and b into dst as parts jobs
+static unsigned ccl_sort_split(struct ccl_sort_job *jobs, unsigned parts, void **a, size_t na,
+	void **b, size_t nb, void **dst, ccl_cmp_cb cmp)
+{
+	size_t d0, d1, i0, i1;
+	unsigned p;
+
+	i0 = d0 = 0;
+	for (p = 0; p < parts; p++) {
+		d1 = (na + nb) * (p + 1) / parts;
+		i1 = (p + 1 == parts ? na : ccl_sort_corank(d1, a, na, b, nb, cmp));
+		jobs[p].a = a + i0;
+		jobs[p].na = i1 - i0;
+		jobs[p].b = (nb ? b + (d0 - i0) : NULL);
+		jobs[p].nb = (d1 - i1) - (d0 - i0);
+		jobs[p].dst = dst + d0;
+		jobs[p].cmp = cmp;
+		i0 = i1;
+		d0 = d1;
+	}
+	return parts;
+}
+
+void ccl_sort_parallel_ex(void **base, size_t n, ccl_cmp_cb cmp, unsigned nthreads, const ccl_allocator *allocator)
+{
+	struct ccl_sort_job jobs[PARALLEL_MAX_THREADS + 1];	// + 1 for an odd run
+	size_t bounds[PARALLEL_MAX_THREADS + 1];
+	void **tmp, **src, **dst, **swap;
+	unsigned runs, pairs, parts, njobs, i;
+
+	if (nthreads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (cpus > 0 ? (unsigned)cpus : 1);
+#else
+		nthreads = 1;
+#endif
+	}
+	if (nthreads > PARALLEL_MAX_THREADS)
+		nthreads = PARALLEL_MAX_THREADS;
+	if (nthreads > n / PARALLEL_MIN_CHUNK)
+		nthreads = (unsigned)(n / PARALLEL_MIN_CHUNK);
+	if (nthreads < 2)
+		goto serial;
+	tmp = ccl_mem_alloc(allocator, n * sizeof(void *));
+	if (tmp == NULL)
+		goto serial;
+
+	// sort one chunk per thread
+	runs = nthreads;
+	for (i = 0; i <= runs; i++)
+		bounds[i] = n * i / runs;
+	for (i = 0; i < runs; i++) {
+		jobs[i].a = base + bounds[i];
+		jobs[i].na = bounds[i + 1] - bounds[i];
+		jobs[i].dst = NULL;
+		jobs[i].cmp = cmp;
+	}
+	ccl_sort_jobs(jobs, runs);
+
+	// merge pairs of runs, ping-ponging between base and tmp
+	src = base;
+	dst = tmp;
+	while (runs > 1) {
+		pairs = runs / 2;
+		parts = nthreads / pairs;
+		njobs = 0;
+		for (i = 0; i < pairs; i++) {
+			njobs += ccl_sort_split(&jobs[njobs], parts,
+				src + bounds[2 * i], bounds[2 * i + 1] - bounds[2 * i],
+				src + bounds[2 * i + 1], bounds[2 * i + 2] - bounds[2 * i + 1],
+				dst + bounds[2 * i], cmp);
+			bounds[i] = bounds[2 * i];
+		}
+		if (runs & 1) {
+			njobs += ccl_sort_split(&jobs[njobs], 1, src + bounds[runs - 1],
+				n - bounds[runs - 1], NULL, 0, dst + bounds[runs - 1], cmp);
+			bounds[pairs] = bounds[runs - 1];
+			pairs++;
+		}
+		bounds[pairs] = n;
+		runs = pairs;
+		ccl_sort_jobs(jobs, njobs);
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != base) {
+		njobs = ccl_sort_split(jobs, nthreads, src, n, NULL, 0, base, cmp);
+		ccl_sort_jobs(jobs, njobs);
+	}
+	ccl_mem_free(allocator, tmp);
+	return;
+serial:
+	ccl_sort(base, n, cmp);
+	return;
+}
+#else
+void ccl_sort_parallel_ex(void **base, size_t n, ccl_cmp_cb cmp, unsigned nthreads, const ccl_allocator *allocator)
+{
+	(void)nthreads;
+	(void)allocator;
+	ccl_sort(base, n, cmp);
+	return;
+}
+#endif
+
+void ccl_sort_parallel(void **base, size_t n, ccl_cmp_cb cmp, unsigned nthreads)
+{
+	ccl_sort_parallel_ex(base, n, cmp, nthreads, NULL);
+	return;
+}
+
+struct ccl_radix_item {
+	uint64_t key;
+	void *ptr;
+};
+
+void ccl_sort_radix_ex(void **base, size_t n, ccl_key64_cb key, size_t cutoff, const ccl_allocator *allocator)
+{
+	size_t hist[8][256], offs[256];
+	struct ccl_radix_item *items, *src, *dst, *swap;
+	size_t i, sum, c;
+	unsigned d, shift;
+	uint64_t k;
+
+	if (n < cutoff || n < 2)
+		goto fallback;
+	items = ccl_mem_alloc(allocator, 2 * n * sizeof(*items));
+	if (items == NULL)
+		goto fallback;
+
+	// extract the keys once and count all eight byte digits in one pass
+	memset(hist, 0, sizeof(hist));
+	for (i = 0; i < n; i++) {
+		k = key(base[i]);
+		items[i].key = k;
+		items[i].ptr = base[i];
+		for (d = 0; d < 8; d++)
+			hist[d][(k >> (d * 8)) & 0xff]++;
+	}
+
+	src = items;
+	dst = items + n;
+	for (d = 0; d < 8; d++) {
+		shift = d * 8;
+		// all keys share this digit, the pass would not move anything
+		if (hist[d][(src[0].key >> shift) & 0xff] == n)
+			continue;
+		for (sum = 0, c = 0; c < 256; c++) {
+			offs[c] = sum;
+			sum += hist[d][c];
+		}
+		for (i = 0; i < n; i++)
+			dst[offs[(src[i].key >> shift) & 0xff]++] = src[i];
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	for (i = 0; i < n; i++)
+		base[i] = src[i].ptr;
+	ccl_mem_free(allocator, items);
+	return;
+fallback:
+	ccl_sort_key(base, n, key);
+	return;
+}
+
+void ccl_sort_radix(void **base, size_t n, ccl_key64_cb key, size_t cutoff)
+{
+	ccl_sort_radix_ex(base, n, key, cutoff, NULL);
+	return;
+}
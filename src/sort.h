@@ -0,0 +1,371 @@
+/*
+   Copyright (C) 2022 Sergey V. Kostyuk
+
+   This file is part of libclassic.
+   Author: Sergey V. Kostyuk <kostyuk.sergey79@gmail.com>
+   Algo: pattern-defeating quicksort, instantiated per element type.
+   Ref: [Peters 2021], [Musser 1997].
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>. */
+
+/*
+ * Sort template, included once per instantiation (no include guard):
+ *
+ *	#define CCL_SORT_NAME		ccl_sort_u64_impl
+ *	#define CCL_SORT_TYPE		uint64_t
+ *	#define CCL_SORT_CTX		void *
+ *	#define CCL_SORT_LESS(ctx, a, b)	((void)(ctx), (a) < (b))
+ *	#include "sort.h"
+ *
+ * defines static void CCL_SORT_NAME(CCL_SORT_TYPE *a, size_t n, CCL_SORT_CTX ctx).
+ * CCL_SORT_LESS must be a strict weak ordering and may evaluate its
+ * arguments more than once; an expression instead of a callback gets the
+ * comparison inlined.  The parameters are undefined at the end.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CCL_SORT_CAT_(a, b)	a ## _ ## b
+#define CCL_SORT_CAT(a, b)	CCL_SORT_CAT_(a, b)
+#define CCL_SORT_FN(f)		CCL_SORT_CAT(CCL_SORT_NAME, f)
+
+#define CCL_SORT_INSERTION	24	// below this size use insertion sort
+#define CCL_SORT_NINTHER	128	// above this size pick the pivot by ninther
+#define CCL_SORT_PARTIAL	8	// moves tolerated by the partial insertion sort
+
+typedef CCL_SORT_TYPE CCL_SORT_FN(t);
+
+static inline void CCL_SORT_FN(swap)(CCL_SORT_FN(t) *a, CCL_SORT_FN(t) *b)
+{
+	CCL_SORT_FN(t) t;
+
+	t = *a;
+	*a = *b;
+	*b = t;
+	return;
+}
+
+static inline void CCL_SORT_FN(sort2)(CCL_SORT_FN(t) *a, CCL_SORT_FN(t) *b, CCL_SORT_CTX ctx)
+{
+	if (CCL_SORT_LESS(ctx, *b, *a))
+		CCL_SORT_FN(swap)(a, b);
+	return;
+}
+
+static inline void CCL_SORT_FN(sort3)(CCL_SORT_FN(t) *a, CCL_SORT_FN(t) *b, CCL_SORT_FN(t) *c, CCL_SORT_CTX ctx)
+{
+	CCL_SORT_FN(sort2)(a, b, ctx);
+	CCL_SORT_FN(sort2)(b, c, ctx);
+	CCL_SORT_FN(sort2)(a, b, ctx);
+	return;
+}
+
+static void CCL_SORT_FN(insertion)(CCL_SORT_FN(t) *begin, CCL_SORT_FN(t) *end, CCL_SORT_CTX ctx)
+{
+	CCL_SORT_FN(t) *cur, *sift, t;
+
+	if (begin == end)
+		return;
+	for (cur = begin + 1; cur != end; cur++) {
+		sift = cur;
+		if (!CCL_SORT_LESS(ctx, *sift, *(sift - 1)))
+			continue;
+		t = *sift;
+		do {
+			*sift = *(sift - 1);
+			sift--;
+		} while (sift != begin && CCL_SORT_LESS(ctx, t, *(sift - 1)));
+		*sift = t;
+	}
+	return;
+}
+
+// begin[-1] must not be greater than any item in [begin, end)
+static void CCL_SORT_FN(unguarded_insertion)(CCL_SORT_FN(t) *begin, CCL_SORT_FN(t) *end, CCL_SORT_CTX ctx)
+{
+	CCL_SORT_FN(t) *cur, *sift, t;
+
+	if (begin == end)
+		return;
+	for (cur = begin + 1; cur != end; cur++) {
+		sift = cur;
+		if (!CCL_SORT_LESS(ctx, *sift, *(sift - 1)))
+			continue;
+		t = *sift;
+		do {
+			*sift = *(sift - 1);
+			sift--;
+		} while (CCL_SORT_LESS(ctx, t, *(sift - 1)));
+		*sift = t;
+	}
+	return;
+}
+
+// insertion sort that gives up after CCL_SORT_PARTIAL moves
+static bool CCL_SORT_FN(partial_insertion)(CCL_SORT_FN(t) *begin, CCL_SORT_FN(t) *end, CCL_SORT_CTX ctx)
+{
+	CCL_SORT_FN(t) *cur, *sift, t;
+	size_t moved;
+
+	if (begin == end)
+		return true;
+	moved = 0;
+	for (cur = begin + 1; cur != end; cur++) {
+		sift = cur;
+		if (!CCL_SORT_LESS(ctx, *sift, *(sift - 1)))
+			continue;
+		t = *sift;
+		do {
+			*sift = *(sift - 1);
+			sift--;
+		} while (sift != begin && CCL_SORT_LESS(ctx, t, *(sift - 1)));
+		*sift = t;
+		moved += (size_t)(cur - sift);
+		if (moved > CCL_SORT_PARTIAL)
+			return false;
+	}
+	return true;
+}
+
+static void CCL_SORT_FN(sift_down)(CCL_SORT_FN(t) *a, size_t i, size_t n, CCL_SORT_CTX ctx)
+{
+	size_t child;
+
+	for (;;) {
+		child = 2 * i + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && CCL_SORT_LESS(ctx, a[child], a[child + 1]))
+			child++;
+		if (!CCL_SORT_LESS(ctx, a[i], a[child]))
+			break;
+		CCL_SORT_FN(swap)(&a[i], &a[child]);
+		i = child;
+	}
+	return;
+}
+
+// fallback that bounds the worst case to O(n log n)
+static void CCL_SORT_FN(heapsort)(CCL_SORT_FN(t) *a, size_t n, CCL_SORT_CTX ctx)
+{
+	size_t i;
+
+	for (i = n / 2; i-- > 0; )
+		CCL_SORT_FN(sift_down)(a, i, n, ctx);
+	for (i = n; i-- > 1; ) {
+		CCL_SORT_FN(swap)(&a[0], &a[i]);
+		CCL_SORT_FN(sift_down)(a, 0, i, ctx);
+	}
+	return;
+}
+
+/*
+ * Partition around the pivot *begin into < pivot and >= pivot.  Returns the
+ * pivot's final position; *done tells that no item had to be swapped.
+ */
+static CCL_SORT_FN(t) *CCL_SORT_FN(partition_right)(CCL_SORT_FN(t) *begin, CCL_SORT_FN(t) *end, bool *done, CCL_SORT_CTX ctx)
+{
+	CCL_SORT_FN(t) pivot, *first, *last;
+
+	pivot = *begin;
+	first = begin;
+	last = end;
+	do
+		first++;
+	while (CCL_SORT_LESS(ctx, *first, pivot));
+	if (first - 1 == begin) {
+		while (first < last) {
+			last--;
+			if (CCL_SORT_LESS(ctx, *last, pivot))
+				break;
+		}
+	} else {
+		do
+			last--;
+		while (!CCL_SORT_LESS(ctx, *last, pivot));
+	}
+	*done = (first >= last);
+	while (first < last) {
+		CCL_SORT_FN(swap)(first, last);
+		do
+			first++;
+		while (CCL_SORT_LESS(ctx, *first, pivot));
+		do
+			last--;
+		while (!CCL_SORT_LESS(ctx, *last, pivot));
+	}
+	first--;
+	*begin = *first;
+	*first = pivot;
+	return first;
+}
+
+// partition into <= pivot and > pivot, used when many items equal the pivot
+static CCL_SORT_FN(t) *CCL_SORT_FN(partition_left)(CCL_SORT_FN(t) *begin, CCL_SORT_FN(t) *end, CCL_SORT_CTX ctx)
+{
+	CCL_SORT_FN(t) pivot, *first, *last;
+
+	pivot = *begin;
+	first = begin;
+	last = end;
+	do
+		last--;
+	while (CCL_SORT_LESS(ctx, pivot, *last));
+	if (last + 1 == end) {
+		while (first < last) {
+			first++;
+			if (CCL_SORT_LESS(ctx, pivot, *first))
+				break;
+		}
+	} else {
+		do
+			first++;
+		while (!CCL_SORT_LESS(ctx, pivot, *first));
+	}
+	while (first < last) {
+		CCL_SORT_FN(swap)(first, last);
+		do
+			last--;
+		while (CCL_SORT_LESS(ctx, pivot, *last));
+		do
+			first++;
+		while (!CCL_SORT_LESS(ctx, pivot, *first));
+	}
+	*begin = *last;
+	*last = pivot;
+	return last;
+}
+
+static void CCL_SORT_FN(loop)(CCL_SORT_FN(t) *begin, CCL_SORT_FN(t) *end, unsigned bad, bool leftmost, CCL_SORT_CTX ctx)
+{
+	CCL_SORT_FN(t) *pivot;
+	size_t size, half, l_size, r_size;
+	bool done;
+
+	for (;;) {
+		size = (size_t)(end - begin);
+		if (size < CCL_SORT_INSERTION) {
+			if (leftmost)
+				CCL_SORT_FN(insertion)(begin, end, ctx);
+			else
+				CCL_SORT_FN(unguarded_insertion)(begin, end, ctx);
+			return;
+		}
+
+		// median of 3, or Tukey's ninther, moved to *begin
+		half = size / 2;
+		if (size > CCL_SORT_NINTHER) {
+			CCL_SORT_FN(sort3)(begin, begin + half, end - 1, ctx);
+			CCL_SORT_FN(sort3)(begin + 1, begin + half - 1, end - 2, ctx);
+			CCL_SORT_FN(sort3)(begin + 2, begin + half + 1, end - 3, ctx);
+			CCL_SORT_FN(sort3)(begin + half - 1, begin + half, begin + half + 1, ctx);
+			CCL_SORT_FN(swap)(begin, begin + half);
+		} else {
+			CCL_SORT_FN(sort3)(begin + half, begin, end - 1, ctx);
+		}
+
+		// the pivot equals the item left of the range: skip the run of equals
+		if (!leftmost && !CCL_SORT_LESS(ctx, *(begin - 1), *begin)) {
+			begin = CCL_SORT_FN(partition_left)(begin, end, ctx) + 1;
+			continue;
+		}
+
+		pivot = CCL_SORT_FN(partition_right)(begin, end, &done, ctx);
+		l_size = (size_t)(pivot - begin);
+		r_size = (size_t)(end - (pivot + 1));
+
+		if (l_size < size / 8 || r_size < size / 8) {
+			// bad split: after too many switch to heapsort, else shuffle
+			if (--bad == 0) {
+				CCL_SORT_FN(heapsort)(begin, size, ctx);
+				return;
+			}
+			if (l_size >= CCL_SORT_INSERTION) {
+				CCL_SORT_FN(swap)(begin, begin + l_size / 4);
+				CCL_SORT_FN(swap)(pivot - 1, pivot - l_size / 4);
+				if (l_size > CCL_SORT_NINTHER) {
+					CCL_SORT_FN(swap)(begin + 1, begin + (l_size / 4 + 1));
+					CCL_SORT_FN(swap)(begin + 2, begin + (l_size / 4 + 2));
+					CCL_SORT_FN(swap)(pivot - 2, pivot - (l_size / 4 + 1));
+					CCL_SORT_FN(swap)(pivot - 3, pivot - (l_size / 4 + 2));
+				}
+			}
+			if (r_size >= CCL_SORT_INSERTION) {
+				CCL_SORT_FN(swap)(pivot + 1, pivot + (1 + r_size / 4));
+				CCL_SORT_FN(swap)(end - 1, end - r_size / 4);
+				if (r_size > CCL_SORT_NINTHER) {
+					CCL_SORT_FN(swap)(pivot + 2, pivot + (2 + r_size / 4));
+					CCL_SORT_FN(swap)(pivot + 3, pivot + (3 + r_size / 4));
+					CCL_SORT_FN(swap)(end - 2, end - (1 + r_size / 4));
+					CCL_SORT_FN(swap)(end - 3, end - (2 + r_size / 4));
+				}
+			}
+		} else if (done && CCL_SORT_FN(partial_insertion)(begin, pivot, ctx)
+		    && CCL_SORT_FN(partial_insertion)(pivot + 1, end, ctx)) {
+			// the split needed no swaps and both halves were nearly sorted
+			return;
+		}
+
+		// recurse into the smaller side, loop on the larger one
+		if (l_size < r_size) {
+			CCL_SORT_FN(loop)(begin, pivot, bad, leftmost, ctx);
+			begin = pivot + 1;
+			leftmost = false;
+		} else {
+			CCL_SORT_FN(loop)(pivot + 1, end, bad, false, ctx);
+			end = pivot;
+		}
+	}
+}
+
+static void CCL_SORT_NAME(CCL_SORT_FN(t) *a, size_t n, CCL_SORT_CTX ctx)
+{
+	size_t i, bad;
+
+	if (n < 2)
+		return;
+
+	// whole input already ascending, or strictly descending: O(n)
+	for (i = 1; i < n && !CCL_SORT_LESS(ctx, a[i], a[i - 1]); i++)
+		;
+	if (i == n)
+		return;
+	if (i == 1) {
+		for (i = 1; i < n && CCL_SORT_LESS(ctx, a[i], a[i - 1]); i++)
+			;
+		if (i == n) {
+			for (i = 0; i < n / 2; i++)
+				CCL_SORT_FN(swap)(&a[i], &a[n - 1 - i]);
+			return;
+		}
+	}
+
+	for (bad = 0; n >> bad > 1; bad++)
+		;
+	CCL_SORT_FN(loop)(a, a + n, (unsigned)bad, true, ctx);
+	return;
+}
+
+#undef CCL_SORT_INSERTION
+#undef CCL_SORT_NINTHER
+#undef CCL_SORT_PARTIAL
+#undef CCL_SORT_FN
+#undef CCL_SORT_CAT
+#undef CCL_SORT_CAT_
+#undef CCL_SORT_NAME
+#undef CCL_SORT_TYPE
+#undef CCL_SORT_CTX
+#undef CCL_SORT_LESS
@@ -24,11 +24,14 @@
 
 #include <classic/sp_tree.h>
 
-static ccl_spnode *ccl_spnode_alloc(void* k, void *v)
+#include "mapiter.h"
+#include "pool.h"
+
+static ccl_spnode *ccl_spnode_alloc(ccl_sptree *tree, void* k, void *v)
 {
 	ccl_spnode *node;
 
-	node = malloc(sizeof(*node));
+	node = ccl_pool_get(tree->pool, tree->allocator, sizeof(*node));
 	if (node == NULL)
 		return NULL;
 	node->key = k;
@@ -39,28 +42,44 @@ static ccl_spnode *ccl_spnode_alloc(void* k, void *v)
 	return node;
 }
 
-static void ccl_spnode_dealloc(ccl_spnode *node, void **k, void **v)
+static void ccl_spnode_dealloc(ccl_sptree *tree, ccl_spnode *node, void **k, void **v)
 {
 	*k = node->key;
 	*v = node->value;
-	free(node);
+	ccl_pool_put(tree->pool, tree->allocator, node);
 	return;
 }
 
-ccl_sptree *ccl_sptree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+ccl_sptree *ccl_sptree_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_sptree *tree;
 
 	if (cmp_cb == NULL)
 		return NULL;
-	tree = malloc(sizeof(*tree));
+	tree = ccl_mem_alloc(allocator, sizeof(*tree));
 	if (tree == NULL)
 		return NULL;
+	tree->root = NULL;
 	tree->cmp = cmp_cb;
 	tree->kfree = kfree_cb;
 	tree->vfree = vfree_cb;
 	tree->count = 0;
+	tree->allocator = allocator;
+	tree->pool = NULL;
+	if (flags & CCL_POOL) {
+		tree->pool = ccl_pool_new_ex(sizeof(ccl_spnode), allocator);
+		if (tree->pool == NULL)
+			goto err;
+	}
 	return tree;
+err:
+	ccl_mem_free(allocator, tree);
+	return NULL;
+}
+
+ccl_sptree *ccl_sptree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+{
+	return ccl_sptree_new_ex(cmp_cb, kfree_cb, vfree_cb, 0, NULL);
 }
 
 size_t ccl_sptree_clear(ccl_sptree *tree)
@@ -69,6 +88,15 @@ size_t ccl_sptree_clear(ccl_sptree *tree)
 	void *k, *v;
 	size_t count;
 
+	if (tree->pool != NULL && tree->kfree == NULL && tree->vfree == NULL) {
+		// nothing to release per node, drop the chunks at once
+		count = tree->count;
+		ccl_pool_clear(tree->pool);
+		tree->root = NULL;
+		tree->count = 0;
+		return count;
+	}
+
 	node = tree->root;
 	count = 0;
 	while (node) {
@@ -83,7 +111,7 @@ size_t ccl_sptree_clear(ccl_sptree *tree)
 		}
 
 		p = node->parent;
-		ccl_spnode_dealloc(node, &k, &v);
+		ccl_spnode_dealloc(tree, node, &k, &v);
 		if (tree->kfree != NULL)
 			tree->kfree(k);
 		if (tree->vfree != NULL)
@@ -106,7 +134,9 @@ size_t ccl_sptree_clear(ccl_sptree *tree)
 void ccl_sptree_free(ccl_sptree *tree)
 {
 	ccl_sptree_clear(tree);
-	free(tree);
+	if (tree->pool != NULL)
+		ccl_pool_free(tree->pool);
+	ccl_mem_free(tree->allocator, tree);
 	return;
 }
 
@@ -282,7 +312,7 @@ bool ccl_sptree_insert(ccl_sptree *tree, void *k, void *v, void **pv)
 
 	// empty tree
 	if (tree->root == NULL) {
-		node = ccl_spnode_alloc(k, v);
+		node = ccl_spnode_alloc(tree, k, v);
 		if (node == NULL) {
 			return false;
 		} else {
@@ -307,7 +337,7 @@ bool ccl_sptree_insert(ccl_sptree *tree, void *k, void *v, void **pv)
 		}
 	}
 
-	node = ccl_spnode_alloc(k, v);
+	node = ccl_spnode_alloc(tree, k, v);
 	if (node == NULL)
 		return false;
 	node->parent = p;
@@ -370,7 +400,7 @@ bool ccl_sptree_unlink(ccl_sptree *tree, void *key, void **k, void **v)
 	// fix tree
 	if (p != NULL)
 		ccl_sptree_splay(tree, p);
-	ccl_spnode_dealloc(rnode, k, v);
+	ccl_spnode_dealloc(tree, rnode, k, v);
 	tree->count--;
 	return true;
 }
@@ -410,6 +440,28 @@ static ccl_spnode *ccl_spnode_next(ccl_spnode *node)
 	return n;
 }
 
+static ccl_spnode *ccl_spnode_prev(ccl_spnode *node)
+{
+	ccl_spnode *n;
+
+	if (node->left) {
+		n = node->left;
+		while (n->right)
+			n = n->right;
+	} else {
+		ccl_spnode *p;
+
+		n = node;
+		p = n->parent;
+		while (p && p->left == n) {
+			n = p;
+			p = p->parent;
+		}
+		n = p;
+	}
+	return n;
+}
+
 bool ccl_sptree_foreach(ccl_sptree *tree, ccl_dforeach_cb cb, void *user)
 {
 	ccl_spnode *node;
@@ -426,29 +478,245 @@ bool ccl_sptree_foreach(ccl_sptree *tree, ccl_dforeach_cb cb, void *user)
 	return true;
 }
 
+/* nodes for sorted keys, linked through ->right; all or nothing */
+static ccl_spnode *ccl_sptree_build_list(ccl_sptree *tree, void **keys, void **values, size_t n)
+{
+	ccl_spnode *head, **pnode, *node;
+	void *k, *v;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (keys[i] == NULL || (i > 0 && tree->cmp(keys[i - 1], keys[i]) >= 0))
+			return NULL;
+	}
+	head = NULL;
+	pnode = &head;
+	for (i = 0; i < n; i++) {
+		node = ccl_spnode_alloc(tree, keys[i], values ? values[i] : NULL);
+		if (node == NULL)
+			goto err;
+		*pnode = node;
+		pnode = &node->right;
+	}
+	return head;
+err:
+	while (head != NULL) {
+		node = head->right;
+		ccl_spnode_dealloc(tree, head, &k, &v);
+		head = node;
+	}
+	return NULL;
+}
+
+/* in-order build from the node list, left subtree gets the larger half */
+static ccl_spnode *ccl_sptree_build_subtree(ccl_spnode **list, size_t n)
+{
+	ccl_spnode *node, *left;
+
+	if (n == 0)
+		return NULL;
+	left = ccl_sptree_build_subtree(list, n / 2);
+	node = *list;
+	*list = node->right;
+	node->left = left;
+	if (left != NULL)
+		left->parent = node;
+	node->right = ccl_sptree_build_subtree(list, n - n / 2 - 1);
+	if (node->right != NULL)
+		node->right->parent = node;
+	return node;
+}
+
+bool ccl_sptree_build_sorted(ccl_sptree *tree, void **keys, void **values, size_t n)
+{
+	ccl_spnode *list;
+
+	if (tree->root != NULL)
+		return false;
+	if (n == 0)
+		return true;
+	list = ccl_sptree_build_list(tree, keys, values, n);
+	if (list == NULL)
+		return false;
+	tree->root = ccl_sptree_build_subtree(&list, n);
+	tree->root->parent = NULL;
+	tree->count = n;
+	return true;
+}
+
+/* first node with key >= k, or > k when strict */
+static ccl_spnode *ccl_sptree_bound_node(ccl_sptree *tree, const void *k, bool strict)
+{
+	ccl_spnode *node, *bound;
+	int ret;
+
+	bound = NULL;
+	node = tree->root;
+	while (node) {
+		ret = tree->cmp(k, node->key);
+		if (ret == 0 && !strict) {
+			bound = node;
+			break;
+		}
+		if (ret < 0) {
+			bound = node;
+			node = node->left;
+		} else {
+			node = node->right;
+		}
+	}
+	if (bound != NULL)
+		ccl_sptree_splay(tree, bound);
+	return bound;
+}
+
+bool ccl_sptree_lower_bound(ccl_sptree *tree, const void *k, void **key, void **value)
+{
+	ccl_spnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_sptree_bound_node(tree, k, false);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+bool ccl_sptree_upper_bound(ccl_sptree *tree, const void *k, void **key, void **value)
+{
+	ccl_spnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_sptree_bound_node(tree, k, true);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+/* entries with lo <= key < hi in order, a NULL bound is open */
+bool ccl_sptree_range_foreach(ccl_sptree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	ccl_spnode *node;
+
+	if (lo != NULL) {
+		node = ccl_sptree_bound_node(tree, lo, false);
+	} else {
+		node = tree->root;
+		while (node && node->left)
+			node = node->left;
+	}
+	for (; node != NULL; node = ccl_spnode_next(node)) {
+		if (hi != NULL && tree->cmp(node->key, hi) >= 0)
+			break;
+		if (!cb(node->key, node->value, user))
+			return false;
+	}
+	return true;
+}
+
+void ccl_sptree_iter_init(ccl_sptree_iter *it, ccl_sptree *tree)
+{
+	it->node = NULL;
+	it->tree = tree;
+	return;
+}
+
+bool ccl_sptree_iter_begin(ccl_sptree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->left)
+		it->node = it->node->left;
+	return (it->node != NULL);
+}
+
+bool ccl_sptree_iter_end(ccl_sptree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->right)
+		it->node = it->node->right;
+	return (it->node != NULL);
+}
+
+/* position on the first entry with key >= k */
+bool ccl_sptree_iter_seek(ccl_sptree_iter *it, const void *k)
+{
+	it->node = (k != NULL ? ccl_sptree_bound_node(it->tree, k, false) : NULL);
+	return (it->node != NULL);
+}
+
+bool ccl_sptree_iter_next(ccl_sptree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_spnode_next(it->node);
+	return (it->node != NULL);
+}
+
+bool ccl_sptree_iter_prev(ccl_sptree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_spnode_prev(it->node);
+	return (it->node != NULL);
+}
+
+void *ccl_sptree_iter_key(ccl_sptree_iter *it)
+{
+	return it->node->key;
+}
+
+void *ccl_sptree_iter_value(ccl_sptree_iter *it)
+{
+	return it->node->value;
+}
+
+CCL_MAP_ITER_OPS(ccl_sptree, ccl_sptree_iter)
+
 static struct ccl_map_ops map_ops = {
-	(ccl_map_free_cb)ccl_sptree_free,
-	(ccl_map_clear_cb)ccl_sptree_clear,
-	(ccl_map_select_cb)ccl_sptree_select,
-	(ccl_map_insert_cb)ccl_sptree_insert,
-	(ccl_map_delete_cb)ccl_sptree_delete,
-	(ccl_map_foreach_cb)ccl_sptree_foreach,
+	.free		= (ccl_map_free_cb)ccl_sptree_free,
+	.clear		= (ccl_map_clear_cb)ccl_sptree_clear,
+	.select		= (ccl_map_select_cb)ccl_sptree_select,
+	.insert		= (ccl_map_insert_cb)ccl_sptree_insert,
+	.delete		= (ccl_map_delete_cb)ccl_sptree_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_sptree_foreach,
+	.build_sorted	= (ccl_map_build_cb)ccl_sptree_build_sorted,
+	.lower_bound	= (ccl_map_bound_cb)ccl_sptree_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_sptree_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_sptree_range_foreach,
+	.iter_begin	= ccl_sptree_map_iter_begin,
+	.iter_end	= ccl_sptree_map_iter_end,
+	.iter_seek	= ccl_sptree_map_iter_seek,
+	.iter_next	= ccl_sptree_map_iter_next,
+	.iter_prev	= ccl_sptree_map_iter_prev,
+	.iter_key	= ccl_sptree_map_iter_key,
+	.iter_value	= ccl_sptree_map_iter_value,
 };
 
-ccl_map *ccl_smap_sptree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+ccl_map *ccl_smap_sptree_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_map *map;
 
-	map = malloc(sizeof(*map));
+	map = ccl_mem_alloc(allocator, sizeof(*map));
 	if (map == NULL)
 		return NULL;
-	map->obj = ccl_sptree_new(cmp_cb, kfree_cb, vfree_cb);
+	map->obj = ccl_sptree_new_ex(cmp_cb, kfree_cb, vfree_cb, flags, allocator);
 	if (map->obj == NULL)
 		goto err;
 	map->ops = &map_ops;
+	map->allocator = allocator;
 	map->sorted = true;
 	return map;
 err:
-	free(map);
+	ccl_mem_free(allocator, map);
 	return NULL;
 }
+
+ccl_map *ccl_smap_sptree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb)
+{
+	return ccl_smap_sptree_ex(cmp_cb, kfree_cb, vfree_cb, 0, NULL);
+}
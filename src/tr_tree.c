@@ -25,11 +25,14 @@
 
 #include <classic/tr_tree.h>
 
-static ccl_trnode *ccl_trnode_alloc(void* k, void *v)
+#include "mapiter.h"
+#include "pool.h"
+
+static ccl_trnode *ccl_trnode_alloc(ccl_trtree *tree, void* k, void *v)
 {
 	ccl_trnode *node;
 
-	node = malloc(sizeof(*node));
+	node = ccl_pool_get(tree->pool, tree->allocator, sizeof(*node));
 	if (node == NULL)
 		return NULL;
 	node->key = k;
@@ -40,29 +43,45 @@ static ccl_trnode *ccl_trnode_alloc(void* k, void *v)
 	return node;
 }
 
-static void ccl_trnode_dealloc(ccl_trnode *node, void **k, void **v)
+static void ccl_trnode_dealloc(ccl_trtree *tree, ccl_trnode *node, void **k, void **v)
 {
 	*k = node->key;
 	*v = node->value;
-	free(node);
+	ccl_pool_put(tree->pool, tree->allocator, node);
 	return;
 }
 
-ccl_trtree *ccl_trtree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_prio_cb prio_cb)
+ccl_trtree *ccl_trtree_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_prio_cb prio_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_trtree *tree;
 
 	if (cmp_cb == NULL || prio_cb == NULL)
 		return NULL;
-	tree = malloc(sizeof(*tree));
+	tree = ccl_mem_alloc(allocator, sizeof(*tree));
 	if (tree == NULL)
 		return NULL;
+	tree->root = NULL;
 	tree->cmp = cmp_cb;
 	tree->kfree = kfree_cb;
 	tree->vfree = vfree_cb;
 	tree->prio = prio_cb;
 	tree->count = 0;
+	tree->allocator = allocator;
+	tree->pool = NULL;
+	if (flags & CCL_POOL) {
+		tree->pool = ccl_pool_new_ex(sizeof(ccl_trnode), allocator);
+		if (tree->pool == NULL)
+			goto err;
+	}
 	return tree;
+err:
+	ccl_mem_free(allocator, tree);
+	return NULL;
+}
+
+ccl_trtree *ccl_trtree_new(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_prio_cb prio_cb)
+{
+	return ccl_trtree_new_ex(cmp_cb, kfree_cb, vfree_cb, prio_cb, 0, NULL);
 }
 
 size_t ccl_trtree_clear(ccl_trtree *tree)
@@ -71,6 +90,15 @@ size_t ccl_trtree_clear(ccl_trtree *tree)
 	void *k, *v;
 	size_t count;
 
+	if (tree->pool != NULL && tree->kfree == NULL && tree->vfree == NULL) {
+		// nothing to release per node, drop the chunks at once
+		count = tree->count;
+		ccl_pool_clear(tree->pool);
+		tree->root = NULL;
+		tree->count = 0;
+		return count;
+	}
+
 	node = tree->root;
 	count = 0;
 	while (node) {
@@ -85,7 +113,7 @@ size_t ccl_trtree_clear(ccl_trtree *tree)
 		}
 
 		p = node->parent;
-		ccl_trnode_dealloc(node, &k, &v);
+		ccl_trnode_dealloc(tree, node, &k, &v);
 		if (tree->kfree != NULL)
 			tree->kfree(k);
 		if (tree->vfree != NULL)
@@ -108,7 +136,9 @@ size_t ccl_trtree_clear(ccl_trtree *tree)
 void ccl_trtree_free(ccl_trtree *tree)
 {
 	ccl_trtree_clear(tree);
-	free(tree);
+	if (tree->pool != NULL)
+		ccl_pool_free(tree->pool);
+	ccl_mem_free(tree->allocator, tree);
 	return;
 }
 
@@ -208,7 +238,7 @@ bool ccl_trtree_insert(ccl_trtree *tree, void *k, void *v, void **pv)
 
 	// empty tree
 	if (tree->root == NULL) {
-		node = ccl_trnode_alloc(k, v);
+		node = ccl_trnode_alloc(tree, k, v);
 		if (node == NULL) {
 			return false;
 		} else {
@@ -234,7 +264,7 @@ bool ccl_trtree_insert(ccl_trtree *tree, void *k, void *v, void **pv)
 		}
 	}
 
-	node = ccl_trnode_alloc(k, v);
+	node = ccl_trnode_alloc(tree, k, v);
 	if (node == NULL)
 		return false;
 	node->priority = tree->prio(k);
@@ -299,7 +329,7 @@ bool ccl_trtree_unlink(ccl_trtree *tree, void *key, void **k, void **v)
 		else
 			p->right = cnode;
 	}
-	ccl_trnode_dealloc(rnode, k, v);
+	ccl_trnode_dealloc(tree, rnode, k, v);
 	tree->count--;
 	return true;
 }
@@ -339,6 +369,28 @@ static ccl_trnode *ccl_trnode_next(ccl_trnode *node)
 	return n;
 }
 
+static ccl_trnode *ccl_trnode_prev(ccl_trnode *node)
+{
+	ccl_trnode *n;
+
+	if (node->left) {
+		n = node->left;
+		while (n->right)
+			n = n->right;
+	} else {
+		ccl_trnode *p;
+
+		n = node;
+		p = n->parent;
+		while (p && p->left == n) {
+			n = p;
+			p = p->parent;
+		}
+		n = p;
+	}
+	return n;
+}
+
 bool ccl_trtree_foreach(ccl_trtree *tree, ccl_dforeach_cb cb, void *user)
 {
 	ccl_trnode *node;
@@ -355,29 +407,242 @@ bool ccl_trtree_foreach(ccl_trtree *tree, ccl_dforeach_cb cb, void *user)
 	return true;
 }
 
+/* nodes for sorted keys, linked through ->right; all or nothing */
+static ccl_trnode *ccl_trtree_build_list(ccl_trtree *tree, void **keys, void **values, size_t n)
+{
+	ccl_trnode *head, **pnode, *node;
+	void *k, *v;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (keys[i] == NULL || (i > 0 && tree->cmp(keys[i - 1], keys[i]) >= 0))
+			return NULL;
+	}
+	head = NULL;
+	pnode = &head;
+	for (i = 0; i < n; i++) {
+		node = ccl_trnode_alloc(tree, keys[i], values ? values[i] : NULL);
+		if (node == NULL)
+			goto err;
+		*pnode = node;
+		pnode = &node->right;
+	}
+	return head;
+err:
+	while (head != NULL) {
+		node = head->right;
+		ccl_trnode_dealloc(tree, head, &k, &v);
+		head = node;
+	}
+	return NULL;
+}
+
+bool ccl_trtree_build_sorted(ccl_trtree *tree, void **keys, void **values, size_t n)
+{
+	ccl_trnode *list, *node, *last, *p, *c;
+
+	if (tree->root != NULL)
+		return false;
+	if (n == 0)
+		return true;
+	list = ccl_trtree_build_list(tree, keys, values, n);
+	if (list == NULL)
+		return false;
+
+	// Cartesian tree: the right spine, walked up from the last node, is the stack
+	last = NULL;
+	while (list != NULL) {
+		node = list;
+		list = node->right;
+		node->priority = tree->prio(node->key);
+		node->right = NULL;
+		for (p = last, c = NULL; p != NULL && p->priority < node->priority; p = p->parent)
+			c = p;
+		node->left = c;
+		if (c != NULL)
+			c->parent = node;
+		node->parent = p;
+		if (p != NULL)
+			p->right = node;
+		else
+			tree->root = node;
+		last = node;
+	}
+	tree->count = n;
+	return true;
+}
+
+/* first node with key >= k, or > k when strict */
+static ccl_trnode *ccl_trtree_bound_node(ccl_trtree *tree, const void *k, bool strict)
+{
+	ccl_trnode *node, *bound;
+	int ret;
+
+	bound = NULL;
+	node = tree->root;
+	while (node) {
+		ret = tree->cmp(k, node->key);
+		if (ret == 0 && !strict) {
+			bound = node;
+			break;
+		}
+		if (ret < 0) {
+			bound = node;
+			node = node->left;
+		} else {
+			node = node->right;
+		}
+	}
+	return bound;
+}
+
+bool ccl_trtree_lower_bound(ccl_trtree *tree, const void *k, void **key, void **value)
+{
+	ccl_trnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_trtree_bound_node(tree, k, false);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+bool ccl_trtree_upper_bound(ccl_trtree *tree, const void *k, void **key, void **value)
+{
+	ccl_trnode *node;
+
+	if (k == NULL)
+		return false;
+	node = ccl_trtree_bound_node(tree, k, true);
+	if (node == NULL)
+		return false;
+	*key = node->key;
+	*value = node->value;
+	return true;
+}
+
+/* entries with lo <= key < hi in order, a NULL bound is open */
+bool ccl_trtree_range_foreach(ccl_trtree *tree, const void *lo, const void *hi, ccl_dforeach_cb cb, void *user)
+{
+	ccl_trnode *node;
+
+	if (lo != NULL) {
+		node = ccl_trtree_bound_node(tree, lo, false);
+	} else {
+		node = tree->root;
+		while (node && node->left)
+			node = node->left;
+	}
+	for (; node != NULL; node = ccl_trnode_next(node)) {
+		if (hi != NULL && tree->cmp(node->key, hi) >= 0)
+			break;
+		if (!cb(node->key, node->value, user))
+			return false;
+	}
+	return true;
+}
+
+void ccl_trtree_iter_init(ccl_trtree_iter *it, ccl_trtree *tree)
+{
+	it->node = NULL;
+	it->tree = tree;
+	return;
+}
+
+bool ccl_trtree_iter_begin(ccl_trtree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->left)
+		it->node = it->node->left;
+	return (it->node != NULL);
+}
+
+bool ccl_trtree_iter_end(ccl_trtree_iter *it)
+{
+	it->node = it->tree->root;
+	while (it->node && it->node->right)
+		it->node = it->node->right;
+	return (it->node != NULL);
+}
+
+/* position on the first entry with key >= k */
+bool ccl_trtree_iter_seek(ccl_trtree_iter *it, const void *k)
+{
+	it->node = (k != NULL ? ccl_trtree_bound_node(it->tree, k, false) : NULL);
+	return (it->node != NULL);
+}
+
+bool ccl_trtree_iter_next(ccl_trtree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_trnode_next(it->node);
+	return (it->node != NULL);
+}
+
+bool ccl_trtree_iter_prev(ccl_trtree_iter *it)
+{
+	if (it->node == NULL)
+		return false;
+	it->node = ccl_trnode_prev(it->node);
+	return (it->node != NULL);
+}
+
+void *ccl_trtree_iter_key(ccl_trtree_iter *it)
+{
+	return it->node->key;
+}
+
+void *ccl_trtree_iter_value(ccl_trtree_iter *it)
+{
+	return it->node->value;
+}
+
+CCL_MAP_ITER_OPS(ccl_trtree, ccl_trtree_iter)
+
 static struct ccl_map_ops map_ops = {
-	(ccl_map_free_cb)ccl_trtree_free,
-	(ccl_map_clear_cb)ccl_trtree_clear,
-	(ccl_map_select_cb)ccl_trtree_select,
-	(ccl_map_insert_cb)ccl_trtree_insert,
-	(ccl_map_delete_cb)ccl_trtree_delete,
-	(ccl_map_foreach_cb)ccl_trtree_foreach,
+	.free		= (ccl_map_free_cb)ccl_trtree_free,
+	.clear		= (ccl_map_clear_cb)ccl_trtree_clear,
+	.select		= (ccl_map_select_cb)ccl_trtree_select,
+	.insert		= (ccl_map_insert_cb)ccl_trtree_insert,
+	.delete		= (ccl_map_delete_cb)ccl_trtree_delete,
+	.foreach	= (ccl_map_foreach_cb)ccl_trtree_foreach,
+	.build_sorted	= (ccl_map_build_cb)ccl_trtree_build_sorted,
+	.lower_bound	= (ccl_map_bound_cb)ccl_trtree_lower_bound,
+	.upper_bound	= (ccl_map_bound_cb)ccl_trtree_upper_bound,
+	.range_foreach	= (ccl_map_range_cb)ccl_trtree_range_foreach,
+	.iter_begin	= ccl_trtree_map_iter_begin,
+	.iter_end	= ccl_trtree_map_iter_end,
+	.iter_seek	= ccl_trtree_map_iter_seek,
+	.iter_next	= ccl_trtree_map_iter_next,
+	.iter_prev	= ccl_trtree_map_iter_prev,
+	.iter_key	= ccl_trtree_map_iter_key,
+	.iter_value	= ccl_trtree_map_iter_value,
 };
 
-ccl_map *ccl_smap_trtree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_prio_cb prio_cb)
+ccl_map *ccl_smap_trtree_ex(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_prio_cb prio_cb, unsigned flags, const ccl_allocator *allocator)
 {
 	ccl_map *map;
 
-	map = malloc(sizeof(*map));
+	map = ccl_mem_alloc(allocator, sizeof(*map));
 	if (map == NULL)
 		return NULL;
-	map->obj = ccl_trtree_new(cmp_cb, kfree_cb, vfree_cb, prio_cb);
+	map->obj = ccl_trtree_new_ex(cmp_cb, kfree_cb, vfree_cb, prio_cb, flags, allocator);
 	if (map->obj == NULL)
 		goto err;
 	map->ops = &map_ops;
+	map->allocator = allocator;
 	map->sorted = true;
 	return map;
 err:
-	free(map);
+	ccl_mem_free(allocator, map);
 	return NULL;
 }
+
+ccl_map *ccl_smap_trtree(ccl_cmp_cb cmp_cb, ccl_free_cb kfree_cb, ccl_free_cb vfree_cb, ccl_prio_cb prio_cb)
+{
+	return ccl_smap_trtree_ex(cmp_cb, kfree_cb, vfree_cb, prio_cb, 0, NULL);
+}
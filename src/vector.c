@@ -19,32 +19,43 @@
    <https://www.gnu.org/licenses/>. */
 
 #include <string.h>
+#include <stdint.h>
+
+#include <classic/sort.h>
 
 #include "vector.h"
+#include "allocator.h"
 
 #define CCL_MAX(x, y) (((x) > (y)) ? (x) : (y))
 
 void ccl_vector_init(ccl_vector *vec, ccl_cmp_cb cmp_cb, ccl_free_cb free_cb)
 {
 	vec->data = NULL;
-	vec->count = vec->capacity = 0;
+	vec->count = vec->capacity = vec->front = 0;
 	vec->cmp = cmp_cb;
 	vec->free = free_cb;
 	vec->sorted = true;
+	vec->allocator = NULL;
 	return;
 }
 
-ccl_vector *ccl_vector_new(ccl_cmp_cb cmp_cb, ccl_free_cb free_cb)
+ccl_vector *ccl_vector_new_ex(ccl_cmp_cb cmp_cb, ccl_free_cb free_cb, const ccl_allocator *allocator)
 {
 	ccl_vector *vec;
 
-	vec = malloc(sizeof(*vec));
+	vec = ccl_mem_alloc(allocator, sizeof(*vec));
 	if (vec == NULL)
 		return vec;
 	ccl_vector_init(vec, cmp_cb, free_cb);
+	vec->allocator = allocator;
 	return vec;
 }
 
+ccl_vector *ccl_vector_new(ccl_cmp_cb cmp_cb, ccl_free_cb free_cb)
+{
+	return ccl_vector_new_ex(cmp_cb, free_cb, NULL);
+}
+
 void ccl_vector_clear(ccl_vector *vec)
 {
 	size_t i;
@@ -55,24 +66,25 @@ void ccl_vector_clear(ccl_vector *vec)
 		for (i = 0; i < vec->count; i++)
 			vec->free(vec->data[i]);
 	}
-	free(vec->data);
+	ccl_mem_free(vec->allocator, vec->data - vec->front);
 	vec->data = NULL;
 	vec->count = 0;
 	vec->capacity = 0;
+	vec->front = 0;
 	return;
 }
 
 void ccl_vector_free(ccl_vector *vec)
 {
 	ccl_vector_clear(vec);
-	free(vec);
+	ccl_mem_free(vec->allocator, vec);
 	return;
 }
 
 
 bool ccl_vector_selectn(ccl_vector *vec, size_t index, size_t count, void **into)
 {
-	if (index + count > vec->count)
+	if (index > vec->count || count > vec->count - index)
 		return false;
 	memcpy(into, &vec->data[index], count * sizeof(void *));
 	return true;
@@ -102,29 +114,152 @@ bool ccl_vector_select(ccl_vector *vec, size_t index, void **into)
                 : vec->capacity <= 12 ? vec->capacity * 2 \
                                       : vec->capacity + (vec->capacity >> 1))
 
+/*
+ * The items sit in the middle of the buffer with free slots on both sides,
+ * so that removing or adding at the head only moves vec->data: FIFO and
+ * deque use is amortized O(1) while the items stay contiguous for indexing,
+ * sorting and searching.  Slack is reclaimed by sliding the items back when
+ * at most half of the buffer is in use, otherwise the buffer grows.
+ */
+
+// slide the items to front within the current buffer
+static void ccl_vector_place(ccl_vector *vec, size_t front)
+{
+	void **buf;
+
+	if (front == vec->front)
+		return;
+	buf = vec->data - vec->front;
+	if (vec->count > 0)
+		memmove(buf + front, vec->data, vec->count * sizeof(void *));
+	vec->data = buf + front;
+	vec->front = front;
+	return;
+}
+
+/*
+ * Resize the buffer with realloc, which grows in place where it can and
+ * lets the C library remap large blocks instead of copying them.  The
+ * items are slid down before shrinking, or up after growing.
+ */
+static bool ccl_vector_resize(ccl_vector *vec, size_t capacity, size_t front)
+{
+	void **buf;
+
+	if (capacity > SIZE_MAX / sizeof(void *))
+		return false;
+	if (front < vec->front)
+		ccl_vector_place(vec, front);
+	buf = ccl_mem_realloc(vec->allocator, (vec->data ? vec->data - vec->front : NULL), capacity * sizeof(void *));
+	if (buf == NULL)
+		return false;
+	vec->data = buf + vec->front;
+	vec->capacity = capacity;
+	ccl_vector_place(vec, front);
+	return true;
+}
+
+// above VECTOR_PAGE_MIN bytes grow by whole pages, which mremap can move
+#define VECTOR_PAGE		4096
+#define VECTOR_PAGE_MIN		(128 * 1024)
+
+static bool ccl_vector_relocate(ccl_vector *vec, size_t need, size_t front)
+{
+	size_t new_capacity, bytes;
+
+	new_capacity = CCL_MAX(NEXT_VECTOR_CAPACITY, need);
+	if (new_capacity < SIZE_MAX / sizeof(void *) - VECTOR_PAGE) {
+		bytes = new_capacity * sizeof(void *);
+		if (bytes >= VECTOR_PAGE_MIN)
+			new_capacity = ((bytes + VECTOR_PAGE - 1) & ~(size_t)(VECTOR_PAGE - 1)) / sizeof(void *);
+	}
+	return ccl_vector_resize(vec, new_capacity, front);
+}
+
+// room for count more items after the last one
+static bool ccl_vector_grow(ccl_vector *vec, size_t count)
+{
+	size_t need;
+
+	need = vec->count + count;
+	if (vec->front + need <= vec->capacity)
+		return true;
+	if (need <= vec->capacity / 2) {
+		ccl_vector_place(vec, 0);
+		return true;
+	}
+	return ccl_vector_relocate(vec, need, 0);
+}
+
+// room for count more items before the first one, half the slack goes in front
+static bool ccl_vector_grow_front(ccl_vector *vec, size_t count)
+{
+	size_t need, new_capacity;
+
+	if (vec->front >= count)
+		return true;
+	need = vec->count + count;
+	if (need <= vec->capacity / 2) {
+		ccl_vector_place(vec, count + (vec->capacity - need) / 2);
+		return true;
+	}
+	new_capacity = CCL_MAX(NEXT_VECTOR_CAPACITY, need);
+	return ccl_vector_relocate(vec, new_capacity, count + (new_capacity - need) / 2);
+}
+
+// make room for n items in total without further reallocation
+bool ccl_vector_reserve(ccl_vector *vec, size_t n)
+{
+	if (vec->front + n <= vec->capacity)
+		return true;
+	if (n <= vec->capacity) {
+		ccl_vector_place(vec, 0);
+		return true;
+	}
+	return ccl_vector_resize(vec, n, 0);
+}
+
+// release the slack on both sides of the items
+bool ccl_vector_shrink_to_fit(ccl_vector *vec)
+{
+	if (vec->data == NULL || vec->count == vec->capacity)
+		return true;
+	if (vec->count == 0) {
+		ccl_mem_free(vec->allocator, vec->data - vec->front);
+		vec->data = NULL;
+		vec->capacity = vec->front = 0;
+		return true;
+	}
+	return ccl_vector_resize(vec, vec->count, 0);
+}
+
+size_t ccl_vector_capacity(ccl_vector *vec)
+{
+	return vec->capacity - vec->front;
+}
+
 bool ccl_vector_insertn(ccl_vector *vec, size_t index, size_t count, void **first)
 {
 	if (count == 0)
 		return true;
 	if (index > vec->count)
 		return false;
-	if (vec->count + count > vec->capacity) {
-		void **data;
-		size_t new_capacity;
-		new_capacity = CCL_MAX(NEXT_VECTOR_CAPACITY, vec->count + count);
-		data = calloc(new_capacity, sizeof(void *));
-		if (data == NULL)
+	if (index < vec->count / 2 && vec->front >= count) {
+		// shorter to shift the items before index towards the front
+		vec->data -= count;
+		vec->front -= count;
+		memmove(vec->data, vec->data + count, index * sizeof(void *));
+	} else if (index == 0 && vec->count > 0) {
+		if (!ccl_vector_grow_front(vec, count))
+			return false;
+		vec->data -= count;
+		vec->front -= count;
+	} else {
+		if (!ccl_vector_grow(vec, count))
 			return false;
-		if (vec->data) {
-			if (vec->count > 0)
-				memcpy(data, vec->data, vec->count * sizeof(void *));
-			free(vec->data);
-		}
-		vec->data = data;
-		vec->capacity = new_capacity;
+		if (index != vec->count)
+			memmove(&vec->data[index + count], &vec->data[index], (vec->count - index) * sizeof(void *));
 	}
-	if (index != vec->count)
-		memmove(&vec->data[index + count], &vec->data[index], (vec->count - index) * sizeof(void *));
 	memcpy(&vec->data[index], first, count * sizeof(void *));
 	vec->count += count;
 	vec->sorted = false;
@@ -157,14 +292,13 @@ bool ccl_vector_updaten(ccl_vector *vec, size_t index, size_t count, void **firs
 
 	if (count == 0)
 		return true;
-	if (index + count > vec->count)
+	if (index > vec->count || count > vec->count - index)
 		return false;
 	if (vec->free) {
 		for (i = 0; i < count; i++)
 			vec->free(vec->data[index + i]);
 	}
 	memcpy(&vec->data[index], first, count * sizeof(void *));
-	vec->count += count;
 	vec->sorted = false;
 	return true;
 }
@@ -179,15 +313,31 @@ bool ccl_vector_update(ccl_vector *vec, size_t index, void *from)
 	return true;
 }
 
+// drop count slots at index, moving whichever side of the gap is shorter
+static void ccl_vector_close(ccl_vector *vec, size_t index, size_t count)
+{
+	size_t after;
+
+	after = vec->count - index - count;
+	if (index < after) {
+		memmove(vec->data + count, vec->data, index * sizeof(void *));
+		vec->data += count;
+		vec->front += count;
+	} else {
+		memmove(&vec->data[index], &vec->data[index + count], after * sizeof(void *));
+	}
+	vec->count -= count;
+	return;
+}
+
 bool ccl_vector_unlinkn(ccl_vector *vec, size_t index, size_t count, void **into)
 {
 	if (count == 0)
 		return false;
-	if (index + count > vec->count)
+	if (index > vec->count || count > vec->count - index)
 		return false;
 	memcpy(into, &vec->data[index], count * sizeof(void *));
-	memmove(&vec->data[index], &vec->data[index + count], count * sizeof(void *));
-	vec->count -= count;
+	ccl_vector_close(vec, index, count);
 	return true;
 }
 
@@ -207,14 +357,13 @@ bool ccl_vector_deleten(ccl_vector *vec, size_t index, size_t count)
 
 	if (count == 0)
 		return true;
-	if (index + count > vec->count)
+	if (index > vec->count || count > vec->count - index)
 		return false;
 	if (vec->free) {
 		for (i = 0; i < count; i++)
 			vec->free(vec->data[index + i]);
 	}
-	memmove(&vec->data[index], &vec->data[index + count], count * sizeof(void *));
-	vec->count -= count;
+	ccl_vector_close(vec, index, count);
 	return true;
 }
 
@@ -232,6 +381,8 @@ bool ccl_vector_push_tail(ccl_vector *vec, void *v)
 
 bool ccl_vector_pop_tail(ccl_vector *vec, void **v)
 {
+	if (vec->count == 0)
+		return false;
 	return ccl_vector_unlink(vec, vec->count - 1, v);
 }
 
@@ -262,11 +413,133 @@ bool ccl_vector_sort(ccl_vector *vec)
 		return false;
 	if (vec->sorted)
 		return true;
-	qsort(vec->data, vec->count, sizeof(void *), vec->cmp);
+	ccl_sort(vec->data, vec->count, vec->cmp);
+	vec->sorted = true;
+	return true;
+}
+
+/*
+ * Radix sort by an extracted 64-bit key, see ccl_sort_radix().  The key
+ * order must agree with vec->cmp, as the vector is marked sorted.
+ */
+bool ccl_vector_sort_radix(ccl_vector *vec, ccl_key64_cb key, size_t cutoff)
+{
+	if (key == NULL)
+		return false;
+	ccl_sort_radix_ex(vec->data, vec->count, key, cutoff, vec->allocator);
+	vec->sorted = true;
+	return true;
+}
+
+// nthreads 0 uses every online CPU, see ccl_sort_parallel()
+bool ccl_vector_sort_parallel(ccl_vector *vec, unsigned nthreads)
+{
+	if (vec->cmp == NULL)
+		return false;
+	if (vec->sorted)
+		return true;
+	ccl_sort_parallel_ex(vec->data, vec->count, vec->cmp, nthreads, vec->allocator);
+	vec->sorted = true;
+	return true;
+}
+
+/*
+ * Index of the first item >= k (strict == false) or > k (strict == true)
+ * in a sorted vector, vec->count if there is none.
+ */
+static size_t ccl_vector_bound(ccl_vector *vec, const void *k, bool strict)
+{
+	size_t lo, hi, mid;
+	int c;
+
+	lo = 0;
+	hi = vec->count;
+	while (lo < hi) {
+		mid = lo + ((hi - lo) >> 1);
+		c = vec->cmp(vec->data[mid], k);
+		if (c < 0 || (strict && c == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * The sorted-vector operations below sort an unsorted vector once and
+ * then keep the sorted flag, so maintaining it never needs a full re-sort.
+ * They fail only without a cmp callback (or on allocation failure).
+ */
+bool ccl_vector_bsearch(ccl_vector *vec, const void *k, size_t *index)
+{
+	size_t i;
+
+	if (!ccl_vector_sort(vec))
+		return false;
+	i = ccl_vector_bound(vec, k, false);
+	if (i == vec->count || vec->cmp(vec->data[i], k) != 0)
+		return false;
+	if (index)
+		*index = i;
+	return true;
+}
+
+bool ccl_vector_lower_bound(ccl_vector *vec, const void *k, size_t *index)
+{
+	if (!ccl_vector_sort(vec))
+		return false;
+	*index = ccl_vector_bound(vec, k, false);
+	return true;
+}
+
+bool ccl_vector_upper_bound(ccl_vector *vec, const void *k, size_t *index)
+{
+	if (!ccl_vector_sort(vec))
+		return false;
+	*index = ccl_vector_bound(vec, k, true);
+	return true;
+}
+
+// equal items keep their insertion order
+bool ccl_vector_insert_sorted(ccl_vector *vec, void *v)
+{
+	if (!ccl_vector_sort(vec))
+		return false;
+	if (!ccl_vector_insert(vec, ccl_vector_bound(vec, v, true), v))
+		return false;
 	vec->sorted = true;
 	return true;
 }
 
+/*
+ * Move all items of src into dst in one linear pass, merging from the back
+ * so no scratch buffer is needed.  Equal items from dst stay first.  src is
+ * left empty; both vectors should share the cmp and free callbacks.
+ */
+bool ccl_vector_merge(ccl_vector *dst, ccl_vector *src)
+{
+	size_t i, j, k;
+
+	if (dst == src)
+		return false;
+	if (!ccl_vector_sort(dst) || !ccl_vector_sort(src))
+		return false;
+	if (!ccl_vector_grow(dst, src->count))
+		return false;
+	i = dst->count;
+	j = src->count;
+	k = i + j;
+	while (j > 0) {
+		if (i > 0 && dst->cmp(src->data[j - 1], dst->data[i - 1]) < 0)
+			dst->data[--k] = dst->data[--i];
+		else
+			dst->data[--k] = src->data[--j];
+	}
+	dst->count += src->count;
+	src->count = 0;
+	return true;
+}
+
 size_t ccl_vector_count(ccl_vector *vec)
 {
 	return vec->count;
@@ -282,21 +555,27 @@ bool ccl_vector_sorted(ccl_vector *vec)
 	return vec->sorted;
 }
 
+void ccl_vector_iter_init(ccl_vector_iter *it, ccl_vector *vec)
+{
+	it->index = 0;
+	it->vec = vec;
+	return;
+}
+
 ccl_vector_iter *ccl_vector_iter_new(ccl_vector *vec)
 {       
 	ccl_vector_iter *it;
 
-	it = malloc(sizeof(*it));
+	it = ccl_mem_alloc(vec->allocator, sizeof(*it));
 	if (it == NULL)
 		return NULL;
-	it->index = 0;
-	it->vec = vec;
+	ccl_vector_iter_init(it, vec);
 	return it;
 }       
 
 void ccl_vector_iter_free(ccl_vector_iter *it)
 {       
-	free(it);
+	ccl_mem_free(it->vec->allocator, it);
 	return;
 }
 
@@ -381,10 +660,7 @@ bool ccl_vector_iter_deleten(ccl_vector_iter *it, size_t count)
 
 	if (vec->count == 0)
 		return false;
-	if (!ccl_vector_deleten(vec, it->index, count))
-		return false;
-	ccl_vector_iter_free(it);
-	return true;
+	return ccl_vector_deleten(vec, it->index, count);
 }
 
 bool ccl_vector_iter_delete(ccl_vector_iter *it)
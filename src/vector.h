@@ -27,14 +27,17 @@
 #include <classic/common.h>
 
 typedef struct ccl_vector_t {
-	void **data;
+	void **data;			// first item, the buffer starts at data - front
 	ccl_cmp_cb cmp;
 	ccl_free_cb free;
 	size_t count;
-	size_t capacity;
+	size_t capacity;		// whole buffer, front slack included
+	size_t front;			// free slots before data
+	const ccl_allocator *allocator;
 	bool sorted;
 } ccl_vector;
 
+// must match the public definition in <classic/vector.h>
 typedef struct ccl_vector_iter_t {
 	size_t index;
 	ccl_vector *vec;